@@ -0,0 +1,84 @@
+// shlog_collectord: drains the shared-memory rings of every ShmLogger process on
+// the host into a single sink.
+//
+// usage: shlog_collectord [-s console|file|uring|direct] [-o path] [-p prefix]
+//                         [-i idle_us]
+
+#include <getopt.h>
+#include <signal.h>
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "shlog/shm_collector.h"
+
+namespace {
+std::atomic<bool> g_stop{false};
+
+void onSignal(int) { g_stop.store(true); }
+
+shlog::SinkPtr makeSink(const std::string& type, const std::string& path) {
+    if (type == "console") return std::make_unique<shlog::ConsoleSink>();
+    if (type == "file") return std::make_unique<shlog::StandardFileSink>(path, true);
+    if (type == "uring") return std::make_unique<shlog::UringFileSink>(path, true);
+    if (type == "direct") return std::make_unique<shlog::DirectFileSink>(path, true);
+    throw std::invalid_argument("unknown sink type: " + type);
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+    std::string type = "file";
+    std::string path = "shlog_collector.log";
+    std::string prefix = shlog::ShmRing::kDefaultPrefix;
+    auto idle = std::chrono::microseconds(200);
+
+    int opt;
+    while ((opt = getopt(argc, argv, "s:o:p:i:h")) != -1) {
+        switch (opt) {
+            case 's':
+                type = optarg;
+                break;
+            case 'o':
+                path = optarg;
+                break;
+            case 'p':
+                prefix = optarg;
+                break;
+            case 'i':
+                idle = std::chrono::microseconds(std::stol(optarg));
+                break;
+            default:
+                std::cerr << "usage: " << argv[0]
+                          << " [-s console|file|uring|direct] [-o path] [-p prefix]"
+                             " [-i idle_us]\n";
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    struct sigaction sa {};
+    sa.sa_handler = onSignal;
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+
+    shlog::ShmCollector collector(makeSink(type, path), prefix);
+
+    auto last_scan = std::chrono::steady_clock::time_point{};
+    while (!g_stop.load()) {
+        auto now = std::chrono::steady_clock::now();
+        if (now - last_scan >= std::chrono::seconds(1)) {
+            collector.scan();
+            last_scan = now;
+        }
+        if (collector.poll() == 0) {
+            std::this_thread::sleep_for(idle);
+        }
+    }
+
+    collector.poll();
+    collector.flush();
+    return 0;
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <fmt/format.h>
+
+#include <concepts>
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace shlog {
+
+// Fixed part of a structured record; thread / pid are left out when 0, logger (the
+// name of a named logger) when empty.
+struct KVHeader {
+    time_t time;
+    const char* level;
+    const char* file;
+    int line;
+    std::string_view msg;
+    size_t thread{0};
+    int pid{0};
+    std::string_view logger{};
+};
+
+// Encodes structured records on the consumer thread, appending to the output line.
+// Encoders are stateless, so one instance may serve several threads.
+class KVEncoder {
+   public:
+    virtual ~KVEncoder() = default;
+
+    virtual void begin(std::string& out, const KVHeader& hdr) const = 0;
+    virtual void fieldString(std::string& out, std::string_view key,
+                             std::string_view value) const = 0;
+    virtual void fieldInt(std::string& out, std::string_view key, int64_t value) const = 0;
+    virtual void fieldUint(std::string& out, std::string_view key, uint64_t value) const = 0;
+    virtual void fieldDouble(std::string& out, std::string_view key, double value) const = 0;
+    virtual void fieldBool(std::string& out, std::string_view key, bool value) const = 0;
+    virtual void end(std::string& out) const = 0;
+};
+
+// {"time":..,"level":"INFO","file":"a.cpp","line":1,"msg":"..","key":value,...}
+class JSONEncoder : public KVEncoder {
+   public:
+    void begin(std::string& out, const KVHeader& hdr) const override;
+    void fieldString(std::string& out, std::string_view key,
+                     std::string_view value) const override;
+    void fieldInt(std::string& out, std::string_view key, int64_t value) const override;
+    void fieldUint(std::string& out, std::string_view key, uint64_t value) const override;
+    void fieldDouble(std::string& out, std::string_view key, double value) const override;
+    void fieldBool(std::string& out, std::string_view key, bool value) const override;
+    void end(std::string& out) const override;
+
+   protected:
+    void key(std::string& out, std::string_view key) const;
+};
+
+// time=.. level=INFO file=a.cpp line=1 msg=".." key=value ...; values are quoted
+// only when they contain spaces, '=', quotes or control characters.
+class LogfmtEncoder : public KVEncoder {
+   public:
+    void begin(std::string& out, const KVHeader& hdr) const override;
+    void fieldString(std::string& out, std::string_view key,
+                     std::string_view value) const override;
+    void fieldInt(std::string& out, std::string_view key, int64_t value) const override;
+    void fieldUint(std::string& out, std::string_view key, uint64_t value) const override;
+    void fieldDouble(std::string& out, std::string_view key, double value) const override;
+    void fieldBool(std::string& out, std::string_view key, bool value) const override;
+    void end(std::string& out) const override;
+};
+
+// The prefix of the format API ("[time][LEVEL][file:line]: msg") followed by logfmt
+// fields, for sinks that mix both kinds of records.
+class TextEncoder : public LogfmtEncoder {
+   public:
+    void begin(std::string& out, const KVHeader& hdr) const override;
+};
+
+// Append s as the contents of a JSON string (without the quotes).
+void escapeJSON(std::string& out, std::string_view s);
+// Append s as a logfmt value, quoted and escaped if needed.
+void escapeLogfmt(std::string& out, std::string_view s);
+
+template <typename T>
+void encodeValue(const KVEncoder& enc, std::string& out, std::string_view key,
+                 const T& value) {
+    if constexpr (std::is_same_v<T, bool>) {
+        enc.fieldBool(out, key, value);
+    } else if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+        enc.fieldString(out, key, value);
+    } else if constexpr (std::is_enum_v<T>) {
+        encodeValue(enc, out, key, static_cast<std::underlying_type_t<T>>(value));
+    } else if constexpr (std::signed_integral<T>) {
+        enc.fieldInt(out, key, value);
+    } else if constexpr (std::unsigned_integral<T>) {
+        enc.fieldUint(out, key, value);
+    } else if constexpr (std::floating_point<T>) {
+        enc.fieldDouble(out, key, value);
+    } else {
+        // anything else fmt can format, as a string
+        fmt::memory_buffer buf;
+        fmt::format_to(std::back_inserter(buf), "{}", value);
+        enc.fieldString(out, key, std::string_view(buf.data(), buf.size()));
+    }
+}
+
+// Type a value is kept as until a deferred record is encoded: every string (array,
+// pointer, string_view, ...) is copied, since what it refers to may be overwritten
+// or gone by the time the consumer gets to it. Keys stay pointers to literals.
+template <typename T, typename U = std::remove_reference_t<T>>
+using KVCapture = std::conditional_t<std::is_convertible_v<const U&, std::string_view>,
+                                     std::string, std::decay_t<T>>;
+
+// Capture the (key, value) pairs of a record for encoding on another thread.
+template <typename... KVs>
+auto captureKVs(KVs&&... kvs) {
+    using Types = std::tuple<KVs...>;
+    auto refs = std::forward_as_tuple(std::forward<KVs>(kvs)...);
+    return [&]<size_t... I>(std::index_sequence<I...>) {
+        return std::tuple_cat(
+            std::tuple<const char*, KVCapture<std::tuple_element_t<2 * I + 1, Types>>>(
+                std::get<2 * I>(refs), std::get<2 * I + 1>(std::move(refs)))...);
+    }(std::make_index_sequence<sizeof...(KVs) / 2>{});
+}
+
+// Encode a record whose fields are the (key, value) pairs of kvs into out.
+template <typename Tuple>
+void encodeKV(const KVEncoder& enc, std::string& out, const KVHeader& hdr,
+              const Tuple& kvs) {
+    out.clear();
+    enc.begin(out, hdr);
+    [&]<size_t... I>(std::index_sequence<I...>) {
+        (encodeValue(enc, out, std::get<2 * I>(kvs), std::get<2 * I + 1>(kvs)), ...);
+    }(std::make_index_sequence<std::tuple_size_v<Tuple> / 2>{});
+    enc.end(out);
+}
+
+}  // namespace shlog
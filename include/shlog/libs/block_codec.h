@@ -0,0 +1,64 @@
+#ifndef _BLOCK_CODEC_H
+#define _BLOCK_CODEC_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace shlog {
+// Block compression used by CompressedFileSink and CompressedLogReader. Codecs are
+// compiled in with SHLOG_LZ4 / SHLOG_ZSTD; NONE (stored blocks) is always there.
+enum class Codec : uint8_t { NONE = 0, LZ4 = 1, ZSTD = 2 };
+
+#if defined(SHLOG_LZ4)
+inline constexpr Codec kDefaultCodec = Codec::LZ4;
+#elif defined(SHLOG_ZSTD)
+inline constexpr Codec kDefaultCodec = Codec::ZSTD;
+#else
+inline constexpr Codec kDefaultCodec = Codec::NONE;
+#endif
+
+// On-disk layout of a compressed log: a sequence of blocks, each a BlockHeader
+// followed by `size` bytes of compressed payload. The raw payload is a sequence of
+// records, each a uint32_t length followed by the message bytes. The sidecar index
+// "<path>.idx" holds one IndexEntry per block.
+inline constexpr uint32_t kBlockMagic = 0x424c4853;  // "SHLB"
+
+struct BlockHeader {
+    uint32_t magic;
+    uint8_t codec;
+    uint8_t reserved[3];
+    uint32_t raw_size;   // bytes of the uncompressed payload
+    uint32_t size;       // bytes of the compressed payload
+    uint32_t count;      // records in the block
+    uint32_t reserved2;
+    uint64_t first_seq;  // sequence number of the first record
+    int64_t first_ts;    // ns since epoch: first record written
+    int64_t last_ts;     // ns since epoch: block sealed
+};
+
+struct IndexEntry {
+    uint64_t offset;  // of the BlockHeader in the log file
+    uint64_t first_seq;
+    int64_t first_ts;
+    int64_t last_ts;
+};
+
+inline constexpr const char* kIndexSuffix = ".idx";
+
+// Whether the codec is compiled in.
+bool codec_available(Codec codec);
+
+// Upper bound of the compressed size of len bytes.
+size_t compress_bound(Codec codec, size_t len);
+
+// Compress src into dst (of capacity cap, at least compress_bound). Level 0 picks
+// the codec's fastest setting. Returns the compressed size, 0 on failure.
+size_t compress(Codec codec, const char* src, size_t len, char* dst, size_t cap,
+                int level = 0);
+
+// Decompress exactly raw_len bytes from src into dst; false if the data is corrupt.
+bool decompress(Codec codec, const char* src, size_t len, char* dst, size_t raw_len);
+
+}  // namespace shlog
+
+#endif  // _BLOCK_CODEC_H
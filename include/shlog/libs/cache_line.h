@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstddef>
+
+namespace shlog {
+// Alignment used to keep independently written atomics on separate cache lines.
+// Two lines to also defeat the adjacent-line prefetcher on x86.
+inline constexpr size_t kCacheLineSize = 64;
+inline constexpr size_t kFalseSharingRange = 2 * kCacheLineSize;
+}
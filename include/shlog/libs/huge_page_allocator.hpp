@@ -0,0 +1,103 @@
+#ifndef _HUGE_PAGE_ALLOCATOR_H
+#define _HUGE_PAGE_ALLOCATOR_H
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <new>
+
+namespace shlog {
+// Allocator for long-lived queue and buffer memory.
+//
+// Allocations are mapped with MAP_HUGETLB when they span at least one huge page,
+// falling back to a regular mapping advised with MADV_HUGEPAGE (transparent huge
+// pages) when no huge pages are reserved. Every page is touched before allocate()
+// returns, so the page faults are paid once at construction rather than on the
+// first burst of log calls. With Lock = true the mapping is also mlock'ed; a failing
+// mlock (e.g. RLIMIT_MEMLOCK) is reported but not fatal.
+template <typename T, bool Lock = false>
+class HugePageAllocator {
+   public:
+    using value_type = T;
+
+    template <typename U>
+    struct rebind {
+        using other = HugePageAllocator<U, Lock>;
+    };
+
+    static constexpr size_t kHugePageSize = 2 << 20;
+
+    HugePageAllocator() noexcept = default;
+
+    template <typename U>
+    HugePageAllocator(const HugePageAllocator<U, Lock>&) noexcept {}
+
+    T* allocate(size_t n) {
+        size_t bytes = map_size(n);
+        void* p = MAP_FAILED;
+
+        if (bytes % kHugePageSize == 0) {
+            p = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        }
+        if (p == MAP_FAILED) {
+            p = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (p == MAP_FAILED) {
+                throw std::bad_alloc();
+            }
+            // best effort: THP may be disabled system-wide
+            ::madvise(p, bytes, MADV_HUGEPAGE);
+        }
+
+        prefault(p, bytes);
+
+        if constexpr (Lock) {
+            if (::mlock(p, bytes) != 0) {
+                std::cerr << "mlock failed: " << strerror(errno) << std::endl;
+            }
+        }
+        return static_cast<T*>(p);
+    }
+
+    void deallocate(T* p, size_t n) noexcept {
+        size_t bytes = map_size(n);
+        if constexpr (Lock) {
+            ::munlock(p, bytes);
+        }
+        ::munmap(p, bytes);
+    }
+
+    template <typename U>
+    bool operator==(const HugePageAllocator<U, Lock>&) const noexcept {
+        return true;
+    }
+
+   private:
+    // Requests of at least one huge page are rounded up to whole huge pages so
+    // they can be served by MAP_HUGETLB; smaller ones to whole base pages.
+    static size_t map_size(size_t n) noexcept {
+        size_t bytes = n * sizeof(T);
+        size_t align = bytes >= kHugePageSize ? kHugePageSize : page_size();
+        return (bytes + align - 1) / align * align;
+    }
+
+    static size_t page_size() noexcept {
+        static const size_t size = ::sysconf(_SC_PAGESIZE);
+        return size;
+    }
+
+    static void prefault(void* p, size_t bytes) noexcept {
+        auto* c = static_cast<volatile char*>(p);
+        for (size_t i = 0; i < bytes; i += page_size()) {
+            c[i] = 0;
+        }
+    }
+};
+
+}  // namespace shlog
+
+#endif  // _HUGE_PAGE_ALLOCATOR_H
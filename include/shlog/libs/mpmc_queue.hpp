@@ -1,19 +1,35 @@
 #ifndef _MPMC_QUEUE_H
 #define _MPMC_QUEUE_H
 
+#include <algorithm>
 #include <atomic>
 #include <memory>
 
+#include "cache_line.h"
+
 namespace shlog {
 // multi-producer multi-consumer queue
-template <typename T, size_t Capacity = 65536>
-class MPMCQueue : private std::allocator<T> {
+//
+// Each slot carries its own ticket on a separate cache line, so producers and
+// consumers working on neighbouring positions do not invalidate each other.
+template <typename T, size_t Capacity = 65536, typename Allocator = std::allocator<T>>
+class MPMCQueue {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+                  "Capacity must be a power of two");
+
+    struct alignas(kCacheLineSize) Slot {
+        std::atomic<size_t> ticket;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    using SlotAllocator =
+        typename std::allocator_traits<Allocator>::template rebind_alloc<Slot>;
+
    public:
-    MPMCQueue() noexcept {
-        data_ = std::allocator_traits<std::allocator<T>>::allocate(*this, Capacity);
-        ticket_ = new std::atomic<size_t>[Capacity];
+    MPMCQueue() {
+        slots_ = std::allocator_traits<SlotAllocator>::allocate(alloc_, Capacity);
         for (size_t i = 0; i < Capacity; ++i) {
-            ticket_[i].store(0, std::memory_order_relaxed);
+            std::construct_at(&slots_[i].ticket, 0);
         }
     }
 
@@ -22,9 +38,13 @@ class MPMCQueue : private std::allocator<T> {
     MPMCQueue& operator=(const MPMCQueue&) = delete;
 
     ~MPMCQueue() {
-        std::destroy(data_, data_ + Capacity);
-        std::allocator_traits<std::allocator<T>>::deallocate(*this, data_, Capacity);
-        delete[] ticket_;
+        for (size_t i = 0; i < Capacity; ++i) {
+            if (slots_[i].ticket.load(std::memory_order_acquire) & 1) {
+                std::destroy_at(ptr(slots_[i]));
+            }
+            std::destroy_at(&slots_[i].ticket);
+        }
+        std::allocator_traits<SlotAllocator>::deallocate(alloc_, slots_, Capacity);
     }
 
     template <typename... Args>
@@ -34,11 +54,40 @@ class MPMCQueue : private std::allocator<T> {
                       "T must be constructible with Args&&...");
 
         auto tail = tail_.fetch_add(1);  // tail: before increment
-        auto id = idx(tail);
-        while (turn(tail) * 2 != ticket_[id].load(std::memory_order_acquire));
+        produce(tail, std::forward<Args>(args)...);
+    }
 
-        std::construct_at(data_ + id, std::forward<Args>(args)...);
-        ticket_[id].store(turn(tail) * 2 + 1, std::memory_order_release);
+    template <typename... Args>
+    bool try_emplace(Args&&... args) noexcept(
+        std::is_nothrow_constructible<T, Args&&...>::value) {
+        static_assert(std::is_constructible<T, Args&&...>::value,
+                      "T must be constructible with Args&&...");
+
+        auto tail = tail_.load(std::memory_order_acquire);
+        while (true) {
+            if (turn(tail) * 2 == slots_[idx(tail)].ticket.load(std::memory_order_acquire)) {
+                if (tail_.compare_exchange_strong(tail, tail + 1)) {
+                    produce(tail, std::forward<Args>(args)...);
+                    return true;
+                }
+            } else {
+                auto prev = tail;
+                tail = tail_.load(std::memory_order_acquire);
+                if (tail == prev) return false;  // full
+            }
+        }
+    }
+
+    // Move [first, first + n) into the queue. The n positions are claimed with a
+    // single fetch_add, so they stay contiguous in queue order.
+    template <typename It>
+    void emplace_bulk(It first, size_t n) noexcept(
+        std::is_nothrow_constructible<T, decltype(std::move(*first))>::value) {
+        if (n == 0) return;
+        auto tail = tail_.fetch_add(n);
+        for (size_t i = 0; i < n; ++i, ++first) {
+            produce(tail + i, std::move(*first));
+        }
     }
 
     void pop(T& result) noexcept {
@@ -46,13 +95,40 @@ class MPMCQueue : private std::allocator<T> {
                       "T must be nothrow destructible");
 
         auto head = head_.fetch_add(1);
-        auto id = idx(head);
+        consume(head, result);
+    }
 
-        while (turn(head) * 2 + 1 != ticket_[id].load(std::memory_order_acquire));
+    bool try_pop(T& result) noexcept { return pop_bulk(&result, 1) == 1; }
 
-        result = std::move(data_[id]);
+    // Claim the longest run (up to max) of ready items with one CAS on head_
+    // and move them into out; returns the number popped (0 if empty).
+    size_t pop_bulk(T* out, size_t max) noexcept {
+        static_assert(std::is_nothrow_destructible<T>::value,
+                      "T must be nothrow destructible");
 
-        ticket_[id].store(turn(head) * 2 + 2, std::memory_order_release);
+        auto head = head_.load(std::memory_order_acquire);
+        while (true) {
+            size_t cnt = 0;
+            while (cnt < max && turn(head + cnt) * 2 + 1 ==
+                                    slots_[idx(head + cnt)].ticket.load(
+                                        std::memory_order_acquire)) {
+                ++cnt;
+            }
+
+            if (cnt == 0) {
+                auto prev = head;
+                head = head_.load(std::memory_order_acquire);
+                if (head == prev) return 0;  // empty
+                continue;
+            }
+
+            if (head_.compare_exchange_strong(head, head + cnt)) {
+                for (size_t i = 0; i < cnt; ++i) {
+                    consume(head + i, out[i]);
+                }
+                return cnt;
+            }
+        }
     }
 
     size_t size() const noexcept {
@@ -65,16 +141,42 @@ class MPMCQueue : private std::allocator<T> {
                tail_.load(std::memory_order_acquire);
     }
 
+    // Backing storage, e.g. for NUMA placement.
+    void* data() const noexcept { return slots_; }
+    static constexpr size_t data_bytes() noexcept { return Capacity * sizeof(Slot); }
+
    private:
-    constexpr size_t idx(size_t i) const noexcept { return i % Capacity; }
+    static constexpr size_t idx(size_t i) noexcept { return i & (Capacity - 1); }
+
+    static constexpr size_t turn(size_t i) noexcept { return i / Capacity; }
+
+    static T* ptr(Slot& slot) noexcept { return reinterpret_cast<T*>(slot.storage); }
+
+    template <typename... Args>
+    void produce(size_t pos, Args&&... args) noexcept(
+        std::is_nothrow_constructible<T, Args&&...>::value) {
+        auto& slot = slots_[idx(pos)];
+        while (turn(pos) * 2 != slot.ticket.load(std::memory_order_acquire));
+
+        std::construct_at(ptr(slot), std::forward<Args>(args)...);
+        slot.ticket.store(turn(pos) * 2 + 1, std::memory_order_release);
+    }
 
-    constexpr size_t turn(size_t i) const noexcept { return i / Capacity; }
+    void consume(size_t pos, T& result) noexcept {
+        auto& slot = slots_[idx(pos)];
+        while (turn(pos) * 2 + 1 != slot.ticket.load(std::memory_order_acquire));
 
-    T* data_;
-    std::atomic<size_t>* ticket_;
-    std::atomic<size_t> head_{0};
-    std::atomic<size_t> tail_{0};
+        result = std::move(*ptr(slot));
+        std::destroy_at(ptr(slot));
+        slot.ticket.store(turn(pos) * 2 + 2, std::memory_order_release);
+    }
+
+    [[no_unique_address]] SlotAllocator alloc_;
+    Slot* slots_;
+    alignas(kFalseSharingRange) std::atomic<size_t> head_{0};
+    alignas(kFalseSharingRange) std::atomic<size_t> tail_{0};
 };
 
+}  // namespace shlog
+
 #endif  // _MPMC_QUEUE_H
-}
\ No newline at end of file
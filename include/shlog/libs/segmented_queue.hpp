@@ -0,0 +1,264 @@
+#ifndef _SEGMENTED_QUEUE_H
+#define _SEGMENTED_QUEUE_H
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <new>
+#include <thread>
+
+#include "cache_line.h"
+
+namespace shlog {
+// Multi-producer single-consumer queue built from fixed-size segments.
+//
+// Positions are claimed from a global ticket like MPMCQueue, but slots live in
+// segments that are installed on demand and handed back to a small recycle pool
+// once the consumer has drained them. Memory therefore follows the actual backlog:
+// it grows under burst up to `max_bytes` (producers spin once the budget is used
+// up, just like a full bounded queue) and shrinks back to `spare_segments` after.
+// The budget covers both the installed segments and the recycle pool.
+template <typename T, size_t SegmentSize = 1024>
+class SegmentedQueue {
+    static_assert(SegmentSize > 0, "SegmentSize must be positive");
+
+    struct Slot {
+        std::atomic<size_t> seq{0};  // position + 1 once the slot is constructed
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    struct Segment {
+        Slot slots[SegmentSize];
+    };
+
+    // A block owns segment `s` for s = index, index + num_blocks_, ...
+    // state encodes (generation, phase) so a stale segment is never reused by a
+    // producer of a later generation.
+    struct alignas(kCacheLineSize) Block {
+        std::atomic<size_t> state{0};
+        Segment* seg{nullptr};
+    };
+
+   public:
+    static constexpr size_t kSegmentBytes = sizeof(Segment);
+
+    explicit SegmentedQueue(size_t max_bytes = 64 << 20, size_t spare_segments = 4) {
+        // the pool is carved out of the budget, leaving at least two blocks
+        size_t segments = std::max<size_t>(3, max_bytes / kSegmentBytes);
+        num_spare_ = std::clamp<size_t>(spare_segments, 1, segments - 2);
+        num_blocks_ = segments - num_spare_;
+        blocks_ = std::make_unique<Block[]>(num_blocks_);
+        for (size_t i = 0; i < num_blocks_; ++i) {
+            blocks_[i].state.store(free_state(i), std::memory_order_relaxed);
+        }
+
+        pool_ = std::make_unique<std::atomic<Segment*>[]>(num_spare_);
+        for (size_t i = 0; i < num_spare_; ++i) {
+            pool_[i].store(new Segment, std::memory_order_relaxed);
+        }
+        segments_.store(num_spare_, std::memory_order_relaxed);
+    }
+
+    // non-copyable
+    SegmentedQueue(const SegmentedQueue&) = delete;
+    SegmentedQueue& operator=(const SegmentedQueue&) = delete;
+
+    ~SegmentedQueue() {
+        size_t tail = tail_.load(std::memory_order_acquire);
+        for (size_t pos = head_.load(std::memory_order_acquire); pos != tail; ++pos) {
+            auto& blk = block(pos);
+            if (blk.state.load(std::memory_order_acquire) != ready_state(seg_id(pos))) {
+                continue;
+            }
+            auto& slot = blk.seg->slots[pos % SegmentSize];
+            if (slot.seq.load(std::memory_order_acquire) == pos + 1) {
+                std::destroy_at(ptr(slot));
+            }
+        }
+        for (size_t i = 0; i < num_blocks_; ++i) {
+            if (blocks_[i].state.load(std::memory_order_acquire) % 3 == 2) {
+                delete blocks_[i].seg;
+            }
+        }
+        for (size_t i = 0; i < num_spare_; ++i) {
+            delete pool_[i].load(std::memory_order_relaxed);
+        }
+    }
+
+    template <typename... Args>
+    void emplace(Args&&... args) noexcept(
+        std::is_nothrow_constructible<T, Args&&...>::value) {
+        static_assert(std::is_constructible<T, Args&&...>::value,
+                      "T must be constructible with Args&&...");
+
+        auto pos = tail_.fetch_add(1, std::memory_order_relaxed);
+        auto& slot = acquire_segment(pos)->slots[pos % SegmentSize];
+
+        std::construct_at(ptr(slot), std::forward<Args>(args)...);
+        slot.seq.store(pos + 1, std::memory_order_release);
+    }
+
+    // Must only be called by the single consumer.
+    void pop(T& result) noexcept {
+        static_assert(std::is_nothrow_destructible<T>::value,
+                      "T must be nothrow destructible");
+
+        auto pos = head_.load(std::memory_order_relaxed);
+        auto& blk = block(pos);
+        while (blk.state.load(std::memory_order_acquire) != ready_state(seg_id(pos)));
+
+        auto& slot = blk.seg->slots[pos % SegmentSize];
+        while (slot.seq.load(std::memory_order_acquire) != pos + 1);
+
+        result = std::move(*ptr(slot));
+        std::destroy_at(ptr(slot));
+
+        // every slot of the segment has been produced and consumed: hand it back
+        if (pos % SegmentSize == SegmentSize - 1) {
+            release_segment(blk, seg_id(pos));
+        }
+        head_.store(pos + 1, std::memory_order_release);
+    }
+
+    bool try_pop(T& result) noexcept { return pop_bulk(&result, 1) == 1; }
+
+    // Move up to max ready items into out; returns the number popped (0 if empty).
+    // Stops early at the first slot a producer has claimed but not yet filled.
+    size_t pop_bulk(T* out, size_t max) noexcept {
+        static_assert(std::is_nothrow_destructible<T>::value,
+                      "T must be nothrow destructible");
+
+        auto head = head_.load(std::memory_order_relaxed);
+        auto tail = tail_.load(std::memory_order_acquire);
+        size_t cnt = 0;
+        for (auto pos = head; cnt < max && pos != tail; ++pos, ++cnt) {
+            auto& blk = block(pos);
+            if (blk.state.load(std::memory_order_acquire) != ready_state(seg_id(pos))) {
+                break;
+            }
+            auto& slot = blk.seg->slots[pos % SegmentSize];
+            if (slot.seq.load(std::memory_order_acquire) != pos + 1) {
+                break;
+            }
+
+            out[cnt] = std::move(*ptr(slot));
+            std::destroy_at(ptr(slot));
+            if (pos % SegmentSize == SegmentSize - 1) {
+                release_segment(blk, seg_id(pos));
+            }
+        }
+        if (cnt > 0) {
+            head_.store(head + cnt, std::memory_order_release);
+        }
+        return cnt;
+    }
+
+    size_t size() const noexcept {
+        return tail_.load(std::memory_order_acquire) -
+               head_.load(std::memory_order_acquire);
+    }
+
+    bool empty() const noexcept {
+        return head_.load(std::memory_order_acquire) ==
+               tail_.load(std::memory_order_acquire);
+    }
+
+    // Upper bound on segment memory (installed segments and the recycle pool),
+    // excluding the block directory.
+    size_t capacity_bytes() const noexcept {
+        return (num_blocks_ + num_spare_) * kSegmentBytes;
+    }
+
+    // Segments currently allocated, installed or pooled.
+    size_t segment_count() const noexcept {
+        return segments_.load(std::memory_order_relaxed);
+    }
+
+    // Times a producer failed to allocate a segment and had to wait for one.
+    size_t alloc_failures() const noexcept {
+        return alloc_failures_.load(std::memory_order_relaxed);
+    }
+
+   private:
+    static constexpr size_t free_state(size_t s) noexcept { return 3 * s; }
+    static constexpr size_t installing_state(size_t s) noexcept { return 3 * s + 1; }
+    static constexpr size_t ready_state(size_t s) noexcept { return 3 * s + 2; }
+
+    static T* ptr(Slot& slot) noexcept { return reinterpret_cast<T*>(slot.storage); }
+
+    static constexpr size_t seg_id(size_t pos) noexcept { return pos / SegmentSize; }
+
+    Block& block(size_t pos) const noexcept { return blocks_[seg_id(pos) % num_blocks_]; }
+
+    // Returns the segment holding `pos`, installing it if this producer is first.
+    // Spins while the block is still owned by an older generation (budget used up).
+    Segment* acquire_segment(size_t pos) noexcept {
+        auto s = seg_id(pos);
+        auto& blk = block(pos);
+        while (true) {
+            auto st = blk.state.load(std::memory_order_acquire);
+            if (st == ready_state(s)) {
+                return blk.seg;
+            }
+            if (st == free_state(s) &&
+                blk.state.compare_exchange_weak(st, installing_state(s),
+                                                std::memory_order_acquire)) {
+                blk.seg = pool_get();
+                blk.state.store(ready_state(s), std::memory_order_release);
+                return blk.seg;
+            }
+        }
+    }
+
+    void release_segment(Block& blk, size_t s) noexcept {
+        pool_put(blk.seg);
+        blk.seg = nullptr;
+        blk.state.store(free_state(s + num_blocks_), std::memory_order_release);
+    }
+
+    // Lock-free: each pool slot is handed over with a single exchange/CAS. The
+    // position is already claimed, so an allocation failure cannot be passed to
+    // the caller: the producer waits for the consumer to recycle a segment (or for
+    // memory to be freed), as it does when the budget is used up.
+    Segment* pool_get() noexcept {
+        while (true) {
+            for (size_t i = 0; i < num_spare_; ++i) {
+                if (pool_[i].load(std::memory_order_relaxed) == nullptr) continue;
+                if (auto* seg = pool_[i].exchange(nullptr, std::memory_order_acquire)) {
+                    return seg;
+                }
+            }
+            if (auto* seg = new (std::nothrow) Segment) {
+                segments_.fetch_add(1, std::memory_order_relaxed);
+                return seg;
+            }
+            alloc_failures_.fetch_add(1, std::memory_order_relaxed);
+            std::this_thread::yield();
+        }
+    }
+
+    void pool_put(Segment* seg) noexcept {
+        for (size_t i = 0; i < num_spare_; ++i) {
+            Segment* expected = nullptr;
+            if (pool_[i].compare_exchange_strong(expected, seg,
+                                                 std::memory_order_release)) {
+                return;
+            }
+        }
+        delete seg;  // pool is full: shrink back
+        segments_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    std::unique_ptr<Block[]> blocks_;
+    size_t num_blocks_;
+    std::unique_ptr<std::atomic<Segment*>[]> pool_;
+    size_t num_spare_;
+    std::atomic<size_t> segments_{0};
+    std::atomic<size_t> alloc_failures_{0};
+    alignas(kFalseSharingRange) std::atomic<size_t> head_{0};
+    alignas(kFalseSharingRange) std::atomic<size_t> tail_{0};
+};
+
+}  // namespace shlog
+
+#endif  // _SEGMENTED_QUEUE_H
@@ -0,0 +1,297 @@
+#ifndef _SHM_RING_H
+#define _SHM_RING_H
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+
+namespace shlog {
+// Multi-producer single-consumer byte ring in POSIX shared memory (/dev/shm).
+//
+// Producers of one process append variable-length records; a collector process
+// attaches by name and drains them. A record is committed by storing its own
+// absolute position (+1) in its header, so the collector can tell committed data
+// from stale bytes of an earlier lap, and after a producer crash it can find every
+// committed record by scanning for headers that name their own position.
+//
+// The producer holds an open-file-description lock on the ring for as long as it
+// has the ring mapped. The kernel drops it when the process dies, so the collector
+// tells a dead producer by probing that lock rather than by the recorded pid, which
+// may have been reused or may belong to another pid namespace.
+class ShmRing {
+    struct Header {
+        uint64_t magic;
+        uint32_t version;
+        int32_t pid;
+        uint64_t capacity;  // bytes in the data area, power of two
+        std::atomic<uint32_t> closed;
+        alignas(128) std::atomic<uint64_t> head;  // collector
+        alignas(128) std::atomic<uint64_t> tail;  // producers
+        alignas(128) std::atomic<uint64_t> dropped;
+    };
+
+    struct Record {
+        std::atomic<uint64_t> seq;  // absolute position + 1 once committed
+        uint32_t size;              // payload bytes
+        uint32_t flags;
+    };
+
+    static constexpr uint64_t kMagic = 0x676f6c6873ULL;  // "shlog"
+    static constexpr uint32_t kVersion = 1;
+    static constexpr uint32_t kPad = 1;
+    static constexpr size_t kDataOffset = 4096;
+    static constexpr size_t kAlign = 16;
+
+   public:
+    static constexpr size_t kDefaultCapacity = 16 << 20;
+    static constexpr const char* kDefaultPrefix = "shlog";
+
+    // Unique ring name for this process: "/<prefix>.<pid>.<ns>". The timestamp keeps
+    // a restarted process that reuses a pid off the ring its predecessor left behind.
+    static std::string make_name(const std::string& prefix = kDefaultPrefix) {
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::system_clock::now().time_since_epoch())
+                      .count();
+        return "/" + prefix + "." + std::to_string(getpid()) + "." + std::to_string(ns);
+    }
+
+    ShmRing() = default;
+    ~ShmRing() { unmap(); }
+
+    ShmRing(const ShmRing&) = delete;
+    ShmRing& operator=(const ShmRing&) = delete;
+
+    // Producer side: create the ring `name` for this process.
+    void create(const std::string& name, size_t capacity = kDefaultCapacity) {
+        if (capacity < 2 * kAlign || (capacity & (capacity - 1)) != 0) {
+            throw std::invalid_argument("ring capacity must be a power of two");
+        }
+        unmap();
+        int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+        if (fd < 0) {
+            throw std::system_error(errno, std::system_category(), "shm_open failed");
+        }
+        if (ftruncate(fd, kDataOffset + capacity) != 0) {
+            int err = errno;
+            ::close(fd);
+            throw std::system_error(err, std::system_category(), "ftruncate failed");
+        }
+        // taken before the magic is published, so no collector sees the ring unlocked
+        struct flock fl = lock_range(F_WRLCK);
+        if (fcntl(fd, F_OFD_SETLK, &fl) != 0) {
+            int err = errno;
+            ::close(fd);
+            throw std::system_error(err, std::system_category(), "ring lock failed");
+        }
+        map(fd, kDataOffset + capacity);
+
+        hdr_->version = kVersion;
+        hdr_->pid = getpid();
+        hdr_->capacity = capacity;
+        hdr_->closed.store(0, std::memory_order_relaxed);
+        hdr_->head.store(0, std::memory_order_relaxed);
+        hdr_->tail.store(0, std::memory_order_relaxed);
+        hdr_->dropped.store(0, std::memory_order_relaxed);
+        // published last: the collector ignores rings without the magic
+        std::atomic_ref<uint64_t>(hdr_->magic).store(kMagic, std::memory_order_release);
+        name_ = name;
+    }
+
+    // Collector side: attach to an existing ring. Returns false if it is not a
+    // (fully initialized) ring.
+    bool attach(const std::string& name) {
+        int fd = shm_open(name.c_str(), O_RDWR, 0);
+        if (fd < 0) return false;
+
+        unmap();
+        struct stat st;
+        if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) <= kDataOffset) {
+            ::close(fd);
+            return false;
+        }
+        map(fd, st.st_size);
+
+        if (std::atomic_ref<uint64_t>(hdr_->magic).load(std::memory_order_acquire) !=
+                kMagic ||
+            hdr_->version != kVersion || kDataOffset + hdr_->capacity != size_) {
+            unmap();
+            return false;
+        }
+        name_ = name;
+        return true;
+    }
+
+    // Append one record; returns false (and counts a drop) if the ring is full.
+    bool write(const char* data, size_t len) {
+        uint64_t cap = hdr_->capacity;
+        uint64_t need = align(sizeof(Record) + len);
+        if (need > cap / 2) {
+            hdr_->dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        uint64_t t = hdr_->tail.load(std::memory_order_relaxed);
+        uint64_t pad;
+        do {
+            uint64_t left = cap - (t & (cap - 1));
+            pad = left < need ? left : 0;  // records never wrap: pad to the end
+            if (t + pad + need - hdr_->head.load(std::memory_order_acquire) > cap) {
+                hdr_->dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+        } while (!hdr_->tail.compare_exchange_weak(t, t + pad + need,
+                                                   std::memory_order_relaxed));
+
+        if (pad > 0) {
+            commit(t, nullptr, pad - sizeof(Record), kPad);
+        }
+        commit(t + pad, data, len, 0);
+        return true;
+    }
+
+    // Collector side: pass every committed record to fn(data, len) in order, up to
+    // the first one still being written. Returns the number of records.
+    template <typename F>
+    size_t drain(F&& fn) {
+        uint64_t h = hdr_->head.load(std::memory_order_relaxed);
+        uint64_t t = hdr_->tail.load(std::memory_order_acquire);
+        size_t cnt = 0;
+        while (h != t) {
+            Record* rec = at(h);
+            if (rec->seq.load(std::memory_order_acquire) != h + 1) break;
+            if (!(rec->flags & kPad)) {
+                fn(reinterpret_cast<const char*>(rec + 1), rec->size);
+                ++cnt;
+            }
+            h += align(sizeof(Record) + rec->size);
+        }
+        hdr_->head.store(h, std::memory_order_release);
+        return cnt;
+    }
+
+    // Collector side, once the producer is gone: pass every committed record left
+    // in the ring to fn, skipping records whose writer died before committing.
+    template <typename F>
+    size_t recover(F&& fn) {
+        uint64_t h = hdr_->head.load(std::memory_order_relaxed);
+        uint64_t t = hdr_->tail.load(std::memory_order_acquire);
+        size_t cnt = 0;
+        while (h < t) {
+            Record* rec = at(h);
+            uint64_t total = align(sizeof(Record) + rec->size);
+            if (rec->seq.load(std::memory_order_acquire) != h + 1 || h + total > t) {
+                h += kAlign;  // not a committed record header: resync
+                continue;
+            }
+            if (!(rec->flags & kPad)) {
+                fn(reinterpret_cast<const char*>(rec + 1), rec->size);
+                ++cnt;
+            }
+            h += total;
+        }
+        hdr_->head.store(t, std::memory_order_release);
+        return cnt;
+    }
+
+    // Producer side: tell the collector no more records will follow. The mapping
+    // stays valid until destruction or the next create().
+    void close() {
+        if (hdr_ != nullptr) {
+            hdr_->closed.store(1, std::memory_order_release);
+        }
+    }
+
+    // Whether the producer may still write: not closed and its ring lock is still
+    // held. A process forked from the producer shares the lock until it exits or
+    // creates its own ring.
+    bool producer_alive() const {
+        if (hdr_->closed.load(std::memory_order_acquire)) return false;
+        struct flock fl = lock_range(F_WRLCK);
+        if (fcntl(fd_, F_OFD_GETLK, &fl) != 0) return true;  // cannot tell: keep waiting
+        return fl.l_type != F_UNLCK;
+    }
+
+    bool empty() const {
+        return hdr_->head.load(std::memory_order_acquire) ==
+               hdr_->tail.load(std::memory_order_acquire);
+    }
+
+    void unlink() { shm_unlink(name_.c_str()); }
+
+    bool valid() const { return hdr_ != nullptr; }
+    int pid() const { return hdr_->pid; }
+    uint64_t dropped() const { return hdr_->dropped.load(std::memory_order_relaxed); }
+    const std::string& name() const { return name_; }
+
+   private:
+    static constexpr uint64_t align(uint64_t n) { return (n + kAlign - 1) & ~(kAlign - 1); }
+
+    // The producer's liveness lock: first byte of the header.
+    static struct flock lock_range(short type) {
+        struct flock fl{};
+        fl.l_type = type;
+        fl.l_whence = SEEK_SET;
+        fl.l_start = 0;
+        fl.l_len = 1;
+        return fl;
+    }
+
+    Record* at(uint64_t pos) const {
+        return reinterpret_cast<Record*>(data_ + (pos & (hdr_->capacity - 1)));
+    }
+
+    void commit(uint64_t pos, const char* data, size_t len, uint32_t flags) {
+        Record* rec = at(pos);
+        rec->size = len;
+        rec->flags = flags;
+        if (len > 0 && data != nullptr) {
+            memcpy(reinterpret_cast<char*>(rec + 1), data, len);
+        }
+        rec->seq.store(pos + 1, std::memory_order_release);
+    }
+
+    void map(int fd, size_t size) {
+        void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED) {
+            int err = errno;
+            ::close(fd);
+            throw std::system_error(err, std::system_category(), "mmap failed");
+        }
+        fd_ = fd;  // kept open: it carries (or probes) the producer's lock
+        hdr_ = static_cast<Header*>(p);
+        data_ = static_cast<char*>(p) + kDataOffset;
+        size_ = size;
+    }
+
+    void unmap() {
+        if (hdr_ != nullptr) {
+            munmap(hdr_, size_);
+            hdr_ = nullptr;
+            data_ = nullptr;
+        }
+        if (fd_ >= 0) {
+            ::close(fd_);
+            fd_ = -1;
+        }
+    }
+
+    Header* hdr_{nullptr};
+    char* data_{nullptr};
+    size_t size_{0};
+    int fd_{-1};
+    std::string name_;
+};
+
+}  // namespace shlog
+
+#endif  // _SHM_RING_H
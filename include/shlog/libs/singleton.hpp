@@ -42,5 +42,6 @@ class Singleton {
 template <typename T>
 typename Singleton<T>::object_creator Singleton<T>::create_object;
 
+}  // namespace shlog
+
 #endif  // _SINGLETON_H
-}
\ No newline at end of file
@@ -1,16 +1,26 @@
 #ifndef _SPSC_QUEUE_H
 #define _SPSC_QUEUE_H
 
+#include <algorithm>
 #include <atomic>
 #include <memory>
 
+#include "cache_line.h"
+
 namespace shlog {
 // Simple lock-free single-producer single-consumer queue
-template <typename T, size_t Capacity = 65536>
-class SPSCQueue : private std::allocator<T> {
+//
+// head_ and tail_ are free-running counters on their own cache lines; each side
+// also keeps a private copy of the other side's index and only reloads the shared
+// one when the cached value says the queue is full (producer) or empty (consumer).
+template <typename T, size_t Capacity = 65536, typename Allocator = std::allocator<T>>
+class SPSCQueue : private Allocator {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+                  "Capacity must be a power of two");
+
    public:
     SPSCQueue() {
-        data_ = std::allocator_traits<std::allocator<T>>::allocate(*this, Capacity);
+        data_ = std::allocator_traits<Allocator>::allocate(*this, Capacity);
     }
 
     // non-copyable
@@ -19,10 +29,10 @@ class SPSCQueue : private std::allocator<T> {
 
     ~SPSCQueue() {
         for (size_t i = head_.load(std::memory_order_acquire);
-             i != tail_.load(std::memory_order_acquire); i = (i + 1) % Capacity) {
-            std::allocator_traits<std::allocator<T>>::destroy(*this, data_ + i);
+             i != tail_.load(std::memory_order_acquire); ++i) {
+            std::allocator_traits<Allocator>::destroy(*this, data_ + idx(i));
         }
-        std::allocator_traits<std::allocator<T>>::deallocate(*this, data_, Capacity);
+        std::allocator_traits<Allocator>::deallocate(*this, data_, Capacity);
     }
 
     template <typename... Args>
@@ -32,12 +42,53 @@ class SPSCQueue : private std::allocator<T> {
                       "T must be constructible with Args&&...");
 
         size_t t = tail_.load(std::memory_order_relaxed);
-        while ((t + 1) % Capacity == head_.load(std::memory_order_acquire));  // (1)
+        while (t - head_cache_ == Capacity) {
+            head_cache_ = head_.load(std::memory_order_acquire);  // (1)
+        }
 
-        std::allocator_traits<std::allocator<T>>::construct(*this, data_ + t,
-                                                            std::forward<Args>(args)...);
+        std::allocator_traits<Allocator>::construct(*this, data_ + idx(t),
+                                                    std::forward<Args>(args)...);
         // (2) synchronizes with (3)
-        tail_.store((t + 1) % Capacity, std::memory_order_release);  // (2)
+        tail_.store(t + 1, std::memory_order_release);  // (2)
+    }
+
+    template <typename... Args>
+    bool try_emplace(Args&&... args) noexcept(
+        std::is_nothrow_constructible<T, Args&&...>::value) {
+        static_assert(std::is_constructible<T, Args&&...>::value,
+                      "T must be constructible with Args&&...");
+
+        size_t t = tail_.load(std::memory_order_relaxed);
+        if (t - head_cache_ == Capacity) {
+            head_cache_ = head_.load(std::memory_order_acquire);
+            if (t - head_cache_ == Capacity) return false;
+        }
+
+        std::allocator_traits<Allocator>::construct(*this, data_ + idx(t),
+                                                    std::forward<Args>(args)...);
+        tail_.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Move [first, first + n) into the queue, publishing every contiguous run of
+    // free slots with a single store. Blocks until all n items are enqueued.
+    template <typename It>
+    void emplace_bulk(It first, size_t n) noexcept(
+        std::is_nothrow_constructible<T, decltype(std::move(*first))>::value) {
+        size_t t = tail_.load(std::memory_order_relaxed);
+        while (n > 0) {
+            while (t - head_cache_ == Capacity) {
+                head_cache_ = head_.load(std::memory_order_acquire);
+            }
+            size_t cnt = std::min(n, Capacity - (t - head_cache_));
+            for (size_t i = 0; i < cnt; ++i, ++first) {
+                std::allocator_traits<Allocator>::construct(
+                    *this, data_ + idx(t + i), std::move(*first));
+            }
+            t += cnt;
+            n -= cnt;
+            tail_.store(t, std::memory_order_release);
+        }
     }
 
     void pop(T& result) noexcept {
@@ -45,19 +96,40 @@ class SPSCQueue : private std::allocator<T> {
                       "T must be nothrow destructible");
 
         size_t h = head_.load(std::memory_order_relaxed);
-        while (h == tail_.load(std::memory_order_acquire));  // (3)
-        result = std::move(data_[h]);
-        std::allocator_traits<std::allocator<T>>::destroy(*this, data_ + h);
-        head_.store((h + 1) % Capacity, std::memory_order_release);  // (4)
+        while (h == tail_cache_) {
+            tail_cache_ = tail_.load(std::memory_order_acquire);  // (3)
+        }
+        result = std::move(data_[idx(h)]);
+        std::allocator_traits<Allocator>::destroy(*this, data_ + idx(h));
+        head_.store(h + 1, std::memory_order_release);  // (4)
     }
 
-    size_t size() const noexcept {
-        size_t diff =
-            tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
-        if (diff < 0) {
-            diff += Capacity;
+    bool try_pop(T& result) noexcept { return pop_bulk(&result, 1) == 1; }
+
+    // Move up to max items into out; returns the number popped (0 if empty).
+    // The whole batch is handed back to the producer with one store.
+    size_t pop_bulk(T* out, size_t max) noexcept {
+        static_assert(std::is_nothrow_destructible<T>::value,
+                      "T must be nothrow destructible");
+
+        size_t h = head_.load(std::memory_order_relaxed);
+        if (h == tail_cache_) {
+            tail_cache_ = tail_.load(std::memory_order_acquire);
+            if (h == tail_cache_) return 0;
+        }
+
+        size_t cnt = std::min(max, tail_cache_ - h);
+        for (size_t i = 0; i < cnt; ++i) {
+            out[i] = std::move(data_[idx(h + i)]);
+            std::allocator_traits<Allocator>::destroy(*this, data_ + idx(h + i));
         }
-        return diff;
+        head_.store(h + cnt, std::memory_order_release);
+        return cnt;
+    }
+
+    size_t size() const noexcept {
+        return tail_.load(std::memory_order_acquire) -
+               head_.load(std::memory_order_acquire);
     }
 
     bool empty() const noexcept {
@@ -65,11 +137,24 @@ class SPSCQueue : private std::allocator<T> {
                tail_.load(std::memory_order_acquire);
     }
 
+    // Backing storage, e.g. for NUMA placement.
+    void* data() const noexcept { return data_; }
+    static constexpr size_t data_bytes() noexcept { return Capacity * sizeof(T); }
+
    private:
+    static constexpr size_t idx(size_t i) noexcept { return i & (Capacity - 1); }
+
     T* data_;  // queue data
-    std::atomic<size_t> head_{0};
-    std::atomic<size_t> tail_{0};
+
+    // consumer side
+    alignas(kFalseSharingRange) std::atomic<size_t> head_{0};
+    size_t tail_cache_{0};
+
+    // producer side
+    alignas(kFalseSharingRange) std::atomic<size_t> tail_{0};
+    size_t head_cache_{0};
 };
 
+}  // namespace shlog
+
 #endif  // _SPSC_QUEUE_H
-}
\ No newline at end of file
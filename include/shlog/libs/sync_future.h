@@ -0,0 +1,43 @@
+#ifndef _SYNC_FUTURE_H
+#define _SYNC_FUTURE_H
+
+#include <atomic>
+#include <memory>
+
+namespace shlog {
+// Completion handle for a durability request: a shared atomic state instead of a
+// std::promise/std::future pair. Copies refer to the same state.
+class SyncFuture {
+   public:
+    SyncFuture() : state_(std::make_shared<std::atomic<int>>(PENDING)) {}
+
+    static SyncFuture make_ready(bool ok = true) {
+        SyncFuture f;
+        f.set(ok);
+        return f;
+    }
+
+    bool is_ready() const noexcept {
+        return state_->load(std::memory_order_acquire) != PENDING;
+    }
+
+    // Block until completed; returns false if the data could not be synced.
+    bool wait() const noexcept {
+        state_->wait(PENDING, std::memory_order_acquire);
+        return state_->load(std::memory_order_acquire) == SYNCED;
+    }
+
+    void set(bool ok) const noexcept {
+        state_->store(ok ? SYNCED : FAILED, std::memory_order_release);
+        state_->notify_all();
+    }
+
+   private:
+    enum { PENDING, SYNCED, FAILED };
+
+    std::shared_ptr<std::atomic<int>> state_;
+};
+
+}  // namespace shlog
+
+#endif  // _SYNC_FUTURE_H
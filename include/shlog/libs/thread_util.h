@@ -0,0 +1,97 @@
+#ifndef _THREAD_UTIL_H
+#define _THREAD_UTIL_H
+
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace shlog {
+// Placement and scheduling of a background (consumer) thread.
+struct ThreadOptions {
+    std::vector<int> cpus{};      // cpu set to pin to; empty keeps the inherited mask
+    std::optional<int> policy{};  // SCHED_OTHER, SCHED_BATCH, SCHED_IDLE, SCHED_FIFO,
+                                  // SCHED_RR; unset keeps the inherited policy
+    int priority{0};              // static priority for SCHED_FIFO / SCHED_RR
+    int nice{0};                  // nice level for the non-realtime policies
+    bool numa_local{true};        // move queue memory to the node of cpus.front()
+};
+
+// Apply options to the calling thread. Failures (e.g. missing CAP_SYS_NICE) are
+// reported and otherwise ignored: logging keeps working with default placement.
+inline void apply_thread_options(const ThreadOptions& opts) {
+    if (!opts.cpus.empty()) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : opts.cpus) {
+            CPU_SET(cpu, &set);
+        }
+        int rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (rc != 0) {
+            std::cerr << "failed to set thread affinity: " << strerror(rc) << std::endl;
+        }
+    }
+
+    if (opts.policy) {
+        sched_param param{};
+        param.sched_priority = opts.priority;
+        int rc = pthread_setschedparam(pthread_self(), *opts.policy, &param);
+        if (rc != 0) {
+            std::cerr << "failed to set scheduling policy: " << strerror(rc) << std::endl;
+        }
+    }
+
+    if (opts.nice != 0 && opts.policy != SCHED_FIFO && opts.policy != SCHED_RR) {
+        if (setpriority(PRIO_PROCESS, gettid(), opts.nice) != 0) {
+            std::cerr << "failed to set nice level: " << strerror(errno) << std::endl;
+        }
+    }
+}
+
+// NUMA node of a cpu, or -1 if unknown (no NUMA sysfs, e.g. single node kernels).
+inline int cpu_numa_node(int cpu) {
+    std::error_code ec;
+    auto dir = std::filesystem::path("/sys/devices/system/cpu") /
+               ("cpu" + std::to_string(cpu));
+    for (auto& entry : std::filesystem::directory_iterator(dir, ec)) {
+        auto name = entry.path().filename().string();
+        if (name.rfind("node", 0) == 0) {
+            return std::stoi(name.substr(4));
+        }
+    }
+    return -1;
+}
+
+// Migrate the pages of [addr, addr + len) to the NUMA node of cpu.
+inline void move_to_cpu_node(void* addr, size_t len, int cpu) {
+    int node = cpu_numa_node(cpu);
+    if (node < 0 || len == 0) return;
+
+    static const uintptr_t page = sysconf(_SC_PAGESIZE);
+    auto begin = reinterpret_cast<uintptr_t>(addr) & ~(page - 1);
+    auto end = reinterpret_cast<uintptr_t>(addr) + len;
+
+    constexpr size_t bits = 8 * sizeof(unsigned long);
+    std::vector<unsigned long> mask(node / bits + 1, 0);
+    mask[node / bits] |= 1UL << (node % bits);
+
+    long rc = syscall(SYS_mbind, begin, end - begin, MPOL_BIND, mask.data(),
+                      mask.size() * bits + 1, MPOL_MF_MOVE);
+    if (rc != 0) {
+        std::cerr << "failed to move memory to node " << node << ": " << strerror(errno)
+                  << std::endl;
+    }
+}
+
+}  // namespace shlog
+
+#endif  // _THREAD_UTIL_H
@@ -4,7 +4,10 @@
 #include <liburing.h>
 #include <unistd.h>
 
+#include <cerrno>
 #include <cstring>
+#include <deque>
+#include <functional>
 #include <iostream>
 #include <memory>
 #include <optional>
@@ -16,14 +19,28 @@ enum class SQ_POLL { DISABLED, ENABLED };
 
 enum class FD_FIXED { NO, YES };
 
+struct UringOptions {
+    int sq_thread_cpu{-1};          // pin the SQPOLL kernel thread; -1 lets the kernel choose
+    unsigned sq_thread_idle{2000};  // ms the SQPOLL thread spins idle before it sleeps
+    int attach_wq_fd{-1};           // share the SQPOLL thread / workers of this ring fd
+};
+
 template <SQ_POLL SQ_POLL_F, FD_FIXED FD_FIXED_F, unsigned int QUEUE_DEPTH = 512>
 class UringAIO {
    public:
-    UringAIO() {
+    explicit UringAIO(const UringOptions& opts = {}) {
         memset(&params_, 0, sizeof(params_));
         if constexpr (SQ_POLL_F == SQ_POLL::ENABLED) {
             params_.flags |= IORING_SETUP_SQPOLL;
-            params_.sq_thread_idle = 2000;
+            params_.sq_thread_idle = opts.sq_thread_idle;
+            if (opts.sq_thread_cpu >= 0) {
+                params_.flags |= IORING_SETUP_SQ_AFF;
+                params_.sq_thread_cpu = opts.sq_thread_cpu;
+            }
+        }
+        if (opts.attach_wq_fd >= 0) {
+            params_.flags |= IORING_SETUP_ATTACH_WQ;
+            params_.wq_fd = opts.attach_wq_fd;
         }
 
         int rc = io_uring_queue_init_params(QUEUE_DEPTH, &ring_, &params_);
@@ -58,11 +75,71 @@ class UringAIO {
                 return false;
             }
             registered_files_ = num;
+            file_pending_.assign(num, 0);
+            file_sync_.assign(num, FileSync{});
+            file_used_.assign(num, true);
+            return true;
+        }
+        return false;
+    }
+
+    // Register an empty fixed-file table of num slots. Files are then installed
+    // and removed one at a time with add_fd / remove_fd.
+    bool register_sparse(int num) {
+        if constexpr (FD_FIXED_F == FD_FIXED::YES) {
+            if (num <= 0) return false;
+            int ret = io_uring_register_files_sparse(&ring_, num);
+            if (ret == -EINVAL) {
+                // pre-5.19 kernels: register a table of empty (-1) entries instead
+                std::vector<int> fds(num, -1);
+                ret = io_uring_register_files(&ring_, fds.data(), num);
+            }
+            if (ret < 0) {
+                std::cerr << "error registering sparse files: " << strerror(-ret)
+                          << std::endl;
+                return false;
+            }
+            registered_files_ = num;
+            file_pending_.assign(num, 0);
+            file_sync_.assign(num, FileSync{});
+            file_used_.assign(num, false);
             return true;
         }
         return false;
     }
 
+    // Install fd into a free slot of the file table; returns the slot or -1.
+    int add_fd(int fd) {
+        if constexpr (FD_FIXED_F == FD_FIXED::YES) {
+            for (int i = 0; i < registered_files_; ++i) {
+                if (file_used_[i]) continue;
+                int ret = io_uring_register_files_update(&ring_, i, &fd, 1);
+                if (ret < 0) {
+                    std::cerr << "error updating files: " << strerror(-ret) << std::endl;
+                    return -1;
+                }
+                file_used_[i] = true;
+                file_sync_[i] = FileSync{};
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    // Wait for the outstanding I/O of a slot and clear it from the file table.
+    void remove_fd(int index) {
+        if constexpr (FD_FIXED_F == FD_FIXED::YES) {
+            if (index < 0 || index >= registered_files_ || !file_used_[index]) return;
+            wait_file(index);
+            int fd = -1;
+            int ret = io_uring_register_files_update(&ring_, index, &fd, 1);
+            if (ret < 0) {
+                std::cerr << "error updating files: " << strerror(-ret) << std::endl;
+            }
+            file_used_[index] = false;
+        }
+    }
+
     // Unregister registered files (if any).
     void unregister_fds() {
         if constexpr (FD_FIXED_F == FD_FIXED::YES) {
@@ -73,15 +150,200 @@ class UringAIO {
                               << std::endl;
                 }
                 registered_files_ = 0;
+                file_pending_.clear();
+                file_sync_.clear();
+                file_used_.clear();
             }
         }
     }
 
-    // Submit an async write.
+    // Submit an async write; the request takes ownership of data.
     void write_async(std::string& data, off_t offset, int fd_or_index) {
+        auto* req = new WriteRequest{std::move(data), offset, fd_or_index};
+        submit_write(req, req->data.c_str(), req->data.size());
+    }
+
+    // Submit an async write of a caller-owned buffer. The buffer must stay valid and
+    // unmodified until the file's I/O has been waited for (wait_file, fsync_and_wait).
+    void write_async(const char* buf, size_t len, off_t offset, int fd_or_index) {
+        submit_write(new WriteRequest{{}, offset, fd_or_index}, buf, len);
+    }
+
+    // Wait for the writes already queued on the given fd (fixed or raw), then submit
+    // an fsync on it and wait for that too. I/O of other files keeps flowing.
+    void fsync_and_wait(int fd_or_index, bool data_only = false) {
+        wait_file(fd_or_index);
+        if (submit_fsync(fd_or_index, data_only, nullptr)) {
+            wait_file(fd_or_index);
+        }
+    }
+
+    // Queue an fsync ordered after the file's queued writes without waiting for it.
+    // It is issued once those writes have completed, as seen when reaping, so the
+    // I/O of other files on the ring never waits for it. done(ok) runs when its
+    // completion is reaped; ok is false if the fsync or any write of the file since
+    // the last such sync failed.
+    void fsync_async(int fd_or_index, std::function<void(bool)> done,
+                     bool data_only = false) {
+        submit_fsync(fd_or_index, data_only, std::move(done));
+    }
+
+    // Hand the queued requests to the kernel now instead of once SUBMIT_BATCH of
+    // them have accumulated.
+    void submit() {
+        int ret = io_uring_submit(&ring_);
+        if (ret < 0) [[unlikely]] {
+            std::cerr << "submit failed: " << strerror(-ret) << std::endl;
+        }
+    }
+
+    // Harvest finished requests without blocking.
+    void reap() { peek_completions(); }
+
+    // Requests of one file not completed yet, after harvesting the finished ones.
+    size_t pending(int fd_or_index) {
+        peek_completions();
+        return file_pending(fd_or_index);
+    }
+
+    // Wait until all I/O submitted for one file has completed.
+    void wait_file(int fd_or_index) {
+        if constexpr (FD_FIXED_F == FD_FIXED::YES) {
+            if (file_pending(fd_or_index) == 0) return;
+            int ret = io_uring_submit(&ring_);
+            if (ret < 0) [[unlikely]] {
+                std::cerr << "submit failed: " << strerror(-ret) << std::endl;
+            }
+            while (file_pending(fd_or_index) > 0) {
+                wait_for_completion();
+            }
+        } else {
+            io_uring_submit(&ring_);
+            wait_all();
+        }
+    }
+
+    int ring_fd() const { return ring_.ring_fd; }
+
+    void close() {
+        if (closed_) return;
+        // drain outstanding I/O
+        wait_all();
+        unregister_fds();
+        io_uring_queue_exit(&ring_);
+        closed_ = true;
+    }
+
+   private:
+    struct WriteRequest {
+        std::string data;
+        off_t offset;
+        int file;  // fd or fixed-file index the request was issued on
+        size_t size{0};
+        std::function<void(bool)> done{nullptr};  // completion callback, if any
+        bool fsync{false};
+        bool failed{false};  // fsync: a write it covers failed
+        uint64_t gen{0};     // write: generation of the file it belongs to
+    };
+
+    // Writes of a file are grouped into generations, each closed by the fsyncs
+    // requested after its writes. A generation's fsyncs are issued once its writes
+    // and those of all earlier generations have completed.
+    struct Generation {
+        size_t writes{0};  // outstanding
+        bool failed{false};
+        std::vector<std::pair<WriteRequest*, unsigned>> fsyncs;  // with fsync flags
+    };
+
+    struct FileSync {
+        std::deque<Generation> gens{1};
+        uint64_t front{0};  // number of gens.front()
+    };
+
+    bool submit_fsync(int fd_or_index, bool data_only, std::function<void(bool)> done) {
+        auto* req = new WriteRequest{{}, 0, fd_or_index, 0, std::move(done)};
+        req->fsync = true;
+        unsigned flags = data_only ? IORING_FSYNC_DATASYNC : 0;
+        ++pending_;
+        ++file_pending(fd_or_index);
+
+        auto& gens = file_sync(fd_or_index).gens;
+        if (gens.size() == 1 && gens.back().writes == 0) {
+            // every earlier write of the file has completed
+            req->failed = gens.back().failed;
+            gens.back().failed = false;
+            return issue_fsync(req, flags);
+        }
+        gens.back().fsyncs.emplace_back(req, flags);
+        gens.emplace_back();
+        // the writes it waits for may still be queued below SUBMIT_BATCH
+        int ret = io_uring_submit(&ring_);
+        if (ret < 0) [[unlikely]] {
+            std::cerr << "submit failed: " << strerror(-ret) << std::endl;
+        }
+        return true;
+    }
+
+    bool issue_fsync(WriteRequest* req, unsigned flags) {
+        io_uring_sqe* sqe = io_uring_get_sqe(&ring_);
+        if (!sqe) [[unlikely]] {
+            // Ensure we at least wait current completions if queue is full
+            wait_sq_space_left();
+            sqe = io_uring_get_sqe(&ring_);
+        }
+        int ret = -EBUSY;
+        if (sqe) [[likely]] {
+            io_uring_prep_fsync(sqe, req->file, flags);
+            if constexpr (FD_FIXED_F == FD_FIXED::YES) {
+                sqe->flags |= IOSQE_FIXED_FILE;
+            }
+            // tagged with the file so its completion is routed like a write
+            io_uring_sqe_set_data(sqe, req);
+            ret = io_uring_submit(&ring_);
+        }
+        if (ret < 0) [[unlikely]] {
+            std::cerr << "submit fsync failed: " << strerror(-ret) << std::endl;
+            --pending_;
+            --file_pending(req->file);
+            if (req->done) req->done(false);
+            delete req;
+            return false;
+        }
+        return true;
+    }
+
+    // Issue the fsyncs whose generations completed while completions were handled.
+    void issue_ready_fsyncs() {
+        while (!ready_.empty()) {
+            auto ready = std::move(ready_);
+            ready_.clear();
+            for (auto& [req, flags] : ready) {
+                issue_fsync(req, flags);
+            }
+        }
+    }
+
+    void write_completed(WriteRequest* req, bool ok) {
+        auto& sync = file_sync(req->file);
+        Generation& gen = sync.gens[req->gen - sync.front];
+        --gen.writes;
+        if (!ok) gen.failed = true;
+        while (sync.gens.size() > 1 && sync.gens.front().writes == 0) {
+            Generation& done = sync.gens.front();
+            for (auto& fsync : done.fsyncs) {
+                fsync.first->failed = done.failed;
+                ready_.push_back(fsync);
+            }
+            sync.gens.pop_front();
+            ++sync.front;
+        }
+    }
+
+    void submit_write(WriteRequest* req, const char* buf, size_t len) {
         if constexpr (FD_FIXED_F == FD_FIXED::YES) {
             if (registered_files_ == 0) [[unlikely]] {
                 std::cerr << "No files registered but write_async requested fixed file\n";
+                delete req;
                 return;
             }
         }
@@ -96,17 +358,21 @@ class UringAIO {
             wait_sq_space_left();
             sqe = io_uring_get_sqe(&ring_);
             if (!sqe) {
-                std::cerr << "failed to get SQE for write" << data << '\n';
+                std::cerr << "failed to get SQE for write of " << len << " bytes\n";
+                delete req;
                 return;
             }
         }
 
         // Prepare initial write
-        io_uring_prep_write(sqe, fd_or_index, data.c_str(), data.size(), offset);
+        io_uring_prep_write(sqe, req->file, buf, len, req->offset);
         if constexpr (FD_FIXED_F == FD_FIXED::YES) {
             sqe->flags |= IOSQE_FIXED_FILE;
         }
-        auto* req = new WriteRequest{std::move(data), offset};
+        req->size = len;
+        auto& sync = file_sync(req->file);
+        sync.gens.back().writes++;
+        req->gen = sync.front + sync.gens.size() - 1;
         io_uring_sqe_set_data(sqe, req);
 
         if (pending_ >= SUBMIT_BATCH) {
@@ -119,60 +385,26 @@ class UringAIO {
         }
 
         ++pending_;
+        ++file_pending(req->file);
     }
 
-    // Submit an fsync on the given fd (fixed or raw) and wait for all pending including
-    // this fsync.
-    void fsync_and_wait(int fd_or_index, bool data_only = false) {
-        io_uring_sqe* sqe = io_uring_get_sqe(&ring_);
-        if (!sqe) [[unlikely]] {
-            // Ensure we at least wait current completions if queue is full
-            wait_sq_space_left();
-            sqe = io_uring_get_sqe(&ring_);
-            if (!sqe) {
-                std::cerr << "failed to get SQE for fsync\n";
-                return;
-            }
-        }
-        unsigned flags = data_only ? IORING_FSYNC_DATASYNC : 0;
-        io_uring_prep_fsync(sqe, fd_or_index, flags);
+    // Outstanding requests per fixed file; raw fds are only tracked in pending_.
+    size_t& file_pending(int fd_or_index) {
         if constexpr (FD_FIXED_F == FD_FIXED::YES) {
-            sqe->flags |= IOSQE_FIXED_FILE;
-        }
-        // No user_data needed for fsync; we track via pending_
-        io_uring_sqe_set_data(sqe, nullptr);
-
-        int ret = io_uring_submit(&ring_);
-        if (ret < 0) [[unlikely]] {
-            std::cerr << "submit fsync failed: " << strerror(-ret) << std::endl;
-            return;
-        }
-        ++pending_;
-
-        // Wait for everything outstanding
-        ret = io_uring_submit(&ring_);
-        if (ret < 0) [[unlikely]] {
-            std::cerr << "submit failed: " << strerror(-ret) << std::endl;
+            return file_pending_[fd_or_index];
+        } else {
+            return pending_unrouted_;
         }
-        // Drain to clear CQEs
-        wait_all();
     }
 
-    void close() {
-        if (closed_) return;
-        // drain outstanding I/O
-        wait_all();
-        unregister_fds();
-        io_uring_queue_exit(&ring_);
-        closed_ = true;
+    FileSync& file_sync(int fd_or_index) {
+        if constexpr (FD_FIXED_F == FD_FIXED::YES) {
+            return file_sync_[fd_or_index];
+        } else {
+            return sync_unrouted_;
+        }
     }
 
-   private:
-    struct WriteRequest {
-        std::string data;
-        off_t offset;
-    };
-
     // Wait for at least one completion. Returns true if the operation completed
     // successfully (or all retries eventually did).
     bool wait_for_completion() {
@@ -184,6 +416,7 @@ class UringAIO {
         }
         bool ret = handle_cqe(cqe);
         io_uring_cqe_seen(&ring_, cqe);
+        issue_ready_fsyncs();
         return ret;
     }
 
@@ -202,6 +435,7 @@ class UringAIO {
             handle_cqe(cqes[i]);
             io_uring_cqe_seen(&ring_, cqes[i]);
         }
+        issue_ready_fsyncs();
     }
 
     void wait_sq_space_left() {
@@ -211,28 +445,33 @@ class UringAIO {
     }
 
     bool handle_cqe(io_uring_cqe* cqe) {
-        // Note: cqe->user_data may be null (e.g., fsync we submitted without data)
+        // Note: cqe->user_data may be null (e.g., a request submitted without data)
         WriteRequest* req = reinterpret_cast<WriteRequest*>(io_uring_cqe_get_data(cqe));
 
         if (req == nullptr) [[unlikely]] {
-            // e.g., fsync completion
+            // untagged completion
             --pending_;
             return true;
         }
 
-        if (cqe->res < 0) [[unlikely]] {
+        --file_pending(req->file);
+        bool ok = cqe->res >= 0;
+        if (!ok) [[unlikely]] {
             std::cerr << "Async write failed: " << strerror(-cqe->res) << " for "
-                      << req->data.size() << " bytes at offset " << req->offset
+                      << req->size << " bytes at offset " << req->offset
                       << std::endl;
-            delete req;
-            --pending_;
-            return false;
+        }
+        if (req->fsync) {
+            // the writes it covers completed before it was issued
+            ok = ok && !req->failed;
+            if (req->done) req->done(ok);
+        } else {
+            write_completed(req, ok);
         }
 
-        // Full write completed
         delete req;
         --pending_;
-        return true;
+        return ok;
     }
 
     static constexpr size_t SUBMIT_BATCH{QUEUE_DEPTH / 2};
@@ -242,8 +481,15 @@ class UringAIO {
     io_uring_params params_{};
     size_t pending_{0};
     int registered_files_{0};
+    std::vector<size_t> file_pending_;
+    std::vector<FileSync> file_sync_;
+    std::vector<bool> file_used_;
+    size_t pending_unrouted_{0};
+    FileSync sync_unrouted_;
+    std::vector<std::pair<WriteRequest*, unsigned>> ready_;  // fsyncs due for issue
     bool closed_{false};
 };
 
+}  // namespace shlog
+
 #endif
-}
\ No newline at end of file
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "libs/block_codec.h"
+
+namespace shlog {
+
+// Reads logs written by CompressedFileSink. Blocks are located through the sidecar
+// index; blocks missing from it (e.g. the index was lost or is behind after a
+// crash) are found by scanning the block headers that follow the last indexed one.
+// Only the blocks overlapping a query are read and decompressed.
+class CompressedLogReader {
+   public:
+    using TimePoint = std::chrono::system_clock::time_point;
+    // Called with the sequence number and text of each record.
+    using RecordCallback = std::function<void(uint64_t seq, std::string_view msg)>;
+
+    explicit CompressedLogReader(const std::string& path);
+    ~CompressedLogReader();
+
+    CompressedLogReader(const CompressedLogReader&) = delete;
+    CompressedLogReader& operator=(const CompressedLogReader&) = delete;
+
+    // Records of the blocks whose time range overlaps [from, to]. Block times are
+    // taken when records are staged, so the range is matched at block granularity.
+    size_t read(TimePoint from, TimePoint to, const RecordCallback& fn);
+    // Records with sequence numbers in [first, last].
+    size_t readSeq(uint64_t first, uint64_t last, const RecordCallback& fn);
+    size_t readAll(const RecordCallback& fn);
+
+    const std::vector<IndexEntry>& blocks() const { return blocks_; }
+    // Sequence number the next record appended to this log gets.
+    uint64_t nextSequence() const { return next_seq_; }
+    // File offset just past the last valid block.
+    off_t end() const { return end_; }
+    // Whether the blocks found by scanning were missing from the sidecar index.
+    bool indexStale() const { return stale_; }
+
+   private:
+    bool readHeader(off_t offset, BlockHeader& hdr);
+    // Decompress block i and pass its records in [first, last] to fn.
+    size_t readBlock(size_t i, uint64_t first, uint64_t last, const RecordCallback& fn);
+
+    int fd_{-1};
+    std::vector<IndexEntry> blocks_;
+    std::vector<char> buf_;
+    std::string raw_;
+    uint64_t next_seq_{0};
+    off_t end_{0};
+    bool stale_{false};
+};
+
+}  // namespace shlog
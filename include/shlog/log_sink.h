@@ -1,15 +1,33 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <functional>
 #include <iostream>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 
+#include "libs/block_codec.h"
+#include "libs/huge_page_allocator.hpp"
 #include "libs/uring_aio.h"
 
 namespace shlog {
 
+enum class LogLevel { TRACE, DEBUG, INFO, WARN, ERROR, FATAL, NONE };
+
 using LogMessage = std::string;
 
+// Durability callback, called with false if the data could not be synced.
+using SyncCallback = std::function<void(bool)>;
+
+// Background sync triggers; 0 disables a trigger.
+struct SyncPolicy {
+    size_t bytes{0};                        // sync once this many bytes are unsynced
+    std::chrono::milliseconds interval{0};  // sync unsynced data at least this often
+};
+
 class LogSinkBase {
    public:
     LogSinkBase() = default;
@@ -17,6 +35,41 @@ class LogSinkBase {
 
     virtual void log(LogMessage&) = 0;
     virtual void flush() = 0;
+
+    // Log msg, accounting it for the sync policy.
+    void write(LogMessage& msg, LogLevel level = LogLevel::INFO) {
+        unsynced_ += msg.size();
+        logWithLevel(msg, level);
+    }
+
+    // Run cb once everything written so far is on stable storage.
+    void syncAsync(SyncCallback cb) { waiters_.push_back(std::move(cb)); }
+
+    // Called by the consumer after each batch and while idle: reaps finished syncs
+    // and issues one sync for all waiters queued since the last call (group commit),
+    // or when the sync policy is due.
+    void commit();
+    // Sync the queued waiters and wait until every sync in flight has called back;
+    // called by the consumer before it exits.
+    void drain();
+
+    void setSyncPolicy(const SyncPolicy& policy) { policy_ = policy; }
+
+   protected:
+    // Sinks that treat levels differently override this; the default ignores it.
+    virtual void logWithLevel(LogMessage& msg, LogLevel) { log(msg); }
+
+    // Make the written data durable, then call every waiter. The default blocks in
+    // flush(); sinks with async I/O override it together with poll().
+    virtual void sync(std::vector<SyncCallback> waiters);
+    virtual void poll() {}
+
+   private:
+    std::vector<SyncCallback> waiters_;
+    std::atomic<size_t> inflight_{0};  // syncs whose callbacks have not run yet
+    SyncPolicy policy_;
+    size_t unsynced_{0};
+    std::chrono::steady_clock::time_point last_sync_{std::chrono::steady_clock::now()};
 };
 
 class FileSinkBase : public LogSinkBase {
@@ -26,6 +79,8 @@ class FileSinkBase : public LogSinkBase {
 
     virtual void open(const std::string& file_path, bool append = false);
     virtual void close();
+    // Cut the file to size, e.g. to drop a torn tail; later writes continue there.
+    virtual void truncate(off_t size);
 
     int fd() const { return fd_; }
     const std::string& path() const { return path_; }
@@ -47,23 +102,180 @@ class StandardFileSink : public FileSinkBase {
     virtual void flush() override;
 };
 
+// One io_uring (and one SQPOLL kernel thread) serving many UringFileSinks through a
+// sparse registered-file table. Sinks may live on different logger threads, so
+// ring access is serialized; wait() and fsync() block without holding the ring.
+class SharedUring {
+   public:
+    static constexpr int kMaxFiles = 64;
+
+    explicit SharedUring(const UringOptions& opts = {});
+
+    // Process-wide ring used by default; created on first use and released once
+    // the last sink using it is gone.
+    static std::shared_ptr<SharedUring> global();
+    // Options (SQPOLL cpu, idle time, ...) the default ring is created with. Only
+    // takes effect before the ring exists; returns false if it is already live.
+    static bool configure(const UringOptions& opts);
+
+    // Returns the fixed-file index of fd.
+    int attach(int fd);
+    void detach(int index);
+
+    void write(LogMessage& msg, int index);
+    // Submitted right away. buf is caller-owned and must stay untouched until
+    // wait(index) / fsync(index).
+    void write(const char* buf, size_t len, off_t offset, int index);
+    void wait(int index);
+    void fsync(int index, bool data_only = false);
+    // fdatasync ordered after the queued writes; done(ok) runs on reap and must not
+    // log through the ring.
+    void fsyncAsync(int index, SyncCallback done);
+    void reap();
+
+    int ring_fd() const { return aio_.ring_fd(); }
+
+   private:
+    std::mutex mutex_;
+    UringAIO<SQ_POLL::ENABLED, FD_FIXED::YES> aio_;
+};
+
 class UringFileSink : public FileSinkBase {
    public:
-    UringFileSink(const std::string& path = "", bool append = false);
+    UringFileSink(const std::string& path = "", bool append = false,
+                  std::shared_ptr<SharedUring> ring = SharedUring::global());
     ~UringFileSink();
 
     virtual void log(LogMessage&) override;
     virtual void flush() override;
 
-    UringAIO<SQ_POLL::ENABLED, FD_FIXED::YES> aio_;
+   protected:
+    virtual void sync(std::vector<SyncCallback> waiters) override;
+    virtual void poll() override;
+
+    std::shared_ptr<SharedUring> ring_;
+    int index_{-1};  // fixed-file index in ring_
 };
 
+// Writes to fd 1 / 2 directly, bypassing iostream and stdio. Output is collected in
+// a buffer per stream and written once it fills up or has been pending for
+// kFlushInterval; messages that do not fit are written together with the buffer in
+// one writev. Non-blocking pipes are waited on when full (EAGAIN). Records at or
+// above stderr_level go to stderr (NONE keeps everything on stdout), and with color
+// set, streams that are terminals get ANSI colors per level.
 class ConsoleSink : public LogSinkBase {
    public:
-    ~ConsoleSink() { flush(); }
+    static constexpr size_t kBufferSize = 64 << 10;
+    static constexpr std::chrono::milliseconds kFlushInterval{50};
+
+    explicit ConsoleSink(LogLevel stderr_level = LogLevel::NONE, bool color = true);
+    ~ConsoleSink();
+
+    virtual void log(LogMessage&) override;
+    virtual void flush() override;
+
+   protected:
+    struct Stream {
+        Stream(int fd, bool color) : fd(fd), color(color) {}
+
+        int fd;
+        bool color;
+        std::string buf;
+        std::chrono::steady_clock::time_point since;  // oldest pending byte
+    };
+
+    virtual void logWithLevel(LogMessage& msg, LogLevel level) override;
+    virtual void poll() override;
+
+    void append(Stream& s, LogMessage& msg, LogLevel level);
+    // Write the buffer, followed by extra (if any), then clear the buffer.
+    void drain(Stream& s, const char* extra = nullptr, size_t extra_len = 0);
+
+    Stream out_;
+    Stream err_;
+    LogLevel stderr_level_;
+};
+
+// Writes through O_DIRECT so log output bypasses (and does not evict) the page cache.
+// Messages are staged in two page-aligned buffers: while one is being written, the
+// other fills up. The file is preallocated in large extents past its end, which do
+// not count towards its size. A flush writes the last partial block padded with
+// zeros; close() and the next append cut the padding off again. Filesystems without
+// O_DIRECT support (e.g. tmpfs) fall back to buffered I/O.
+class DirectFileSink : public FileSinkBase {
+   public:
+    static constexpr size_t kAlignment = 4096;
+    static constexpr size_t kBufferSize = 2 << 20;
+    static constexpr off_t kExtentSize = 64 << 20;
+
+    DirectFileSink(const std::string& path = "", bool append = false,
+                   std::shared_ptr<SharedUring> ring = SharedUring::global());
+    ~DirectFileSink();
+
+    virtual void log(LogMessage&) override;
+    virtual void flush() override;
+    virtual void close() override;
+    // Drops staged data past size too.
+    virtual void truncate(off_t size) override;
+
+   protected:
+    // Cut the zero padding a flush left after the last record.
+    void trimPadding();
+    // Position the buffers at offset_, reloading an unaligned tail block.
+    void loadTail();
+    // Write the first len bytes of the active buffer at file_off_.
+    void submit(size_t len);
+    void reserve(off_t end);
+
+    std::shared_ptr<SharedUring> ring_;
+    int index_{-1};
+    HugePageAllocator<char> alloc_;
+    char* bufs_[2]{nullptr, nullptr};
+    int cur_{0};         // buffer being filled
+    size_t fill_{0};     // bytes staged in bufs_[cur_]
+    off_t file_off_{0};  // file offset of bufs_[cur_], always aligned
+    off_t allocated_{0};
+    bool fallocate_{true};
+};
+
+// Packs messages into blocks of about block_size bytes, compresses each block on the
+// consumer thread and writes it through a file sink, so the file sink sees one large
+// write per block instead of one per message. Every block is also recorded in a
+// sidecar index ("<path>.idx") with its offset, first sequence number and time
+// range, which lets CompressedLogReader seek without decompressing the whole file.
+// A partial block is sealed on sync and once it is older than kMaxBlockAge.
+class CompressedFileSink : public LogSinkBase {
+   public:
+    static constexpr size_t kBlockSize = 64 << 10;
+    static constexpr std::chrono::milliseconds kMaxBlockAge{1000};
+
+    // Appends if file already holds a compressed log, continuing its sequence.
+    CompressedFileSink(std::unique_ptr<FileSinkBase> file, Codec codec = kDefaultCodec,
+                       size_t block_size = kBlockSize, int level = 0);
+    ~CompressedFileSink();
+
+    virtual void log(LogMessage&) override;
+    virtual void flush() override;
+
+    uint64_t sequence() const { return seq_ + count_; }
+
+   protected:
+    virtual void sync(std::vector<SyncCallback> waiters) override;
+    virtual void poll() override;
+
+    // Compress the staged records into one block and write it.
+    void seal();
 
-    void log(LogMessage& msg) override { std::cout << msg.data(); }
-    void flush() override { fflush(stdout); }
+    std::unique_ptr<FileSinkBase> file_;
+    int index_fd_{-1};
+    Codec codec_;
+    size_t block_size_;
+    int level_;
+    std::string raw_;      // staged records of the open block
+    uint32_t count_{0};    // records in raw_
+    uint64_t seq_{0};      // sequence number of the first record in raw_
+    int64_t first_ts_{0};  // when the first record of raw_ was staged
+    off_t offset_{0};      // file offset of the next block
 };
 
 using SinkPtr = std::unique_ptr<LogSinkBase>;
@@ -2,24 +2,54 @@
 #define _LOGGER_H
 
 #include <fmt/core.h>
+#include <fmt/format.h>
 
+#include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <ctime>
 #include <functional>
 #include <mutex>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <thread>
+#include <vector>
 
+#include "libs/huge_page_allocator.hpp"
 #include "libs/mpmc_queue.hpp"
 #include "libs/noncopyable.h"
+#include "libs/segmented_queue.hpp"
+#include "libs/shm_ring.h"
 #include "libs/singleton.hpp"
 #include "libs/spsc_queue.hpp"
+#include "libs/sync_future.h"
+#include "libs/thread_util.h"
+#include "kv_encoder.h"
 #include "log_sink.h"
 
+// Byte budget of the task queue when built with SHLOG_SEGMENTED_QUEUE. Fixed at
+// compile time and the same for every logger: each queue gets its own budget of this
+// size, there is no per-logger setting.
+#ifndef SHLOG_QUEUE_MEMORY_LIMIT
+#define SHLOG_QUEUE_MEMORY_LIMIT (64 << 20)
+#endif
+
 namespace shlog {
 
-enum class LogLevel { TRACE, DEBUG, INFO, WARN, ERROR, FATAL, NONE };
+using LogTask = std::function<void()>;
+
+// SHLOG_HUGEPAGE_QUEUE backs the task queues with pre-faulted (huge) pages,
+// SHLOG_MLOCK_QUEUE additionally pins them in memory.
+#ifdef SHLOG_HUGEPAGE_QUEUE
+#ifdef SHLOG_MLOCK_QUEUE
+using LogTaskAllocator = HugePageAllocator<LogTask, true>;
+#else
+using LogTaskAllocator = HugePageAllocator<LogTask>;
+#endif
+#else
+using LogTaskAllocator = std::allocator<LogTask>;
+#endif
 
 class LoggerBase : noncopyable {
    public:
@@ -31,6 +61,10 @@ class LoggerBase : noncopyable {
 
     void setLogLevel(LogLevel level) { level_ = level; }
     void setLogSink(SinkPtr sink) { sink_ = std::move(sink); }
+    // Encoder of the records logged through logKV (text by default)
+    void setKVEncoder(std::unique_ptr<KVEncoder> encoder) {
+        kvEncoder_ = std::move(encoder);
+    }
 
    protected:
     LoggerBase() = default;
@@ -56,8 +90,172 @@ class LoggerBase : noncopyable {
         }
     }
 
+    // Move the queue memory to the NUMA node of the consumer's first cpu
+    template <typename Queue>
+    static void placeQueue(Queue& queue, const ThreadOptions& opts) {
+        if constexpr (requires { queue.data(); }) {
+            if (opts.numa_local && !opts.cpus.empty()) {
+                move_to_cpu_node(queue.data(), queue.data_bytes(), opts.cpus.front());
+            }
+        }
+    }
+
+    // Max number of tasks the consumer drains from the queue per handshake
+    static constexpr size_t kTaskBatch = 256;
+    // How often a consumer waiting for formatted batches still commits the sink
+    static constexpr std::chrono::microseconds kIdleCommitInterval{100};
+
+    // Parallel formatting (init with format_threads > 0): formatter threads claim
+    // batches of tasks from the queue together with a sequence number and run them
+    // into the slot of that number; the consumer thread writes the slots to the sink
+    // in sequence order, so output order stays enqueue order.
+    struct FormatEntry {
+        LogMessage line;  // swapped with the emitted line
+        LogLevel level;
+        LogTask task;  // sink work that must run in order, instead of a line
+    };
+
+    struct FormatSlot {
+        std::atomic<uint64_t> state;  // 2s: free for batch s, 2s + 1: holds batch s
+        std::vector<FormatEntry> entries;
+        size_t size{0};
+    };
+
+    struct FormatStage {
+        static constexpr size_t kSlots = 64;
+
+        explicit FormatStage(size_t formatters) : running(formatters) {
+            for (size_t i = 0; i < kSlots; i++) {
+                slots[i].state.store(2 * i, std::memory_order_relaxed);
+            }
+        }
+
+        std::mutex claim;  // pop and sequence number are taken together
+        uint64_t claimed{0};
+        std::atomic<size_t> running;  // formatters that have not exited yet
+        FormatSlot slots[kSlots];
+    };
+
+    // Slot being filled by the calling formatter thread, if any
+    static inline thread_local FormatSlot* formatSlot_{nullptr};
+
+    // Called by log tasks with their formatted line
+    void emit(LogMessage& line, LogLevel level) {
+        if (formatSlot_ == nullptr) {
+            sink_->write(line, level);
+            return;
+        }
+        // swap instead of copy: the task gets the entry's old buffer back for its next
+        // line (an empty one if the sink took the buffer over, as UringFileSink does)
+        FormatEntry& entry = nextEntry();
+        entry.line.swap(line);
+        entry.level = level;
+    }
+
+    // Called by tasks that use the sink otherwise (e.g. sync points)
+    void runOrdered(LogTask task) {
+        if (formatSlot_ == nullptr) {
+            task();
+            return;
+        }
+        nextEntry().task = std::move(task);
+    }
+
+    static FormatEntry& nextEntry() {
+        auto& entries = formatSlot_->entries;
+        if (formatSlot_->size == entries.size()) {
+            entries.emplace_back();
+        }
+        return entries[formatSlot_->size++];
+    }
+
+    // Output line of a structured record; lines are per thread since formatters run
+    // tasks concurrently
+    static LogMessage& kvLine() {
+        thread_local LogMessage line;
+        return line;
+    }
+
+    // Formatter thread: claim and run batches until stopped() and the queue is empty.
+    template <typename Queue, typename Stopped>
+    void formatLogTasks(Queue& queue, FormatStage& stage, Stopped stopped) {
+        LogTask tasks[kTaskBatch];
+        while (true) {
+            size_t cnt;
+            uint64_t seq;
+            bool drained;
+            // stop first: only an empty queue seen after it was set holds every task
+            // queued before stop()
+            bool stop = stopped();
+            {
+                std::lock_guard<std::mutex> lock(stage.claim);
+                cnt = queue.pop_bulk(tasks, kTaskBatch);
+                seq = cnt > 0 ? stage.claimed++ : 0;
+                drained = cnt == 0 && queue.empty();
+            }
+            if (cnt == 0) {
+                if (stop && drained) break;
+                std::this_thread::yield();
+                continue;
+            }
+
+            FormatSlot& slot = stage.slots[seq % FormatStage::kSlots];
+            while (slot.state.load(std::memory_order_acquire) != 2 * seq) {
+                std::this_thread::yield();
+            }
+            slot.size = 0;
+            formatSlot_ = &slot;
+            for (size_t i = 0; i < cnt; i++) {
+                if (tasks[i]) tasks[i]();
+                tasks[i] = nullptr;
+            }
+            formatSlot_ = nullptr;
+            slot.state.store(2 * seq + 1, std::memory_order_release);
+        }
+        stage.running.fetch_sub(1, std::memory_order_release);
+    }
+
+    // Consumer thread: write the formatted batches in order until the formatters
+    // have exited and every batch is written.
+    void writeLogBatches(FormatStage& stage) {
+        auto committed = std::chrono::steady_clock::now();
+        for (uint64_t next = 0;; ++next) {
+            FormatSlot& slot = stage.slots[next % FormatStage::kSlots];
+            while (slot.state.load(std::memory_order_acquire) != 2 * next + 1) {
+                if (stage.running.load(std::memory_order_acquire) == 0 &&
+                    slot.state.load(std::memory_order_acquire) != 2 * next + 1) {
+                    // formatters publish all their batches before exiting
+                    return;
+                }
+                // reap syncs and run time-based flushes while waiting, but leave the
+                // cpu to the formatters in between
+                auto now = std::chrono::steady_clock::now();
+                if (now - committed >= kIdleCommitInterval) {
+                    sink_->commit();
+                    committed = now;
+                }
+                std::this_thread::yield();
+            }
+
+            for (size_t i = 0; i < slot.size; i++) {
+                FormatEntry& entry = slot.entries[i];
+                if (entry.task) {
+                    entry.task();
+                    entry.task = nullptr;
+                } else {
+                    sink_->write(entry.line, entry.level);
+                }
+            }
+            slot.state.store(2 * (next + FormatStage::kSlots), std::memory_order_release);
+            // one sync for every sync point of the batch
+            sink_->commit();
+            committed = std::chrono::steady_clock::now();
+        }
+    }
+
     SinkPtr sink_{nullptr};
     LogLevel level_{LogLevel::NONE};
+    std::unique_ptr<KVEncoder> kvEncoder_{std::make_unique<TextEncoder>()};
 };
 
 class MTLogger : public LoggerBase, public Singleton<MTLogger> {
@@ -66,8 +264,12 @@ class MTLogger : public LoggerBase, public Singleton<MTLogger> {
    public:
     ~MTLogger();
 
-    // Initialize logger with output file
-    void init(LogLevel level = LogLevel::INFO, SinkPtr = std::make_unique<ConsoleSink>());
+    // Initialize logger with output sink; thread_opts places the consumer thread.
+    // With format_threads > 0, that many threads, placed by format_opts, format
+    // records in parallel and the consumer only writes them, in enqueue order.
+    void init(LogLevel level = LogLevel::INFO, SinkPtr = std::make_unique<ConsoleSink>(),
+              const ThreadOptions& thread_opts = {}, size_t format_threads = 0,
+              const ThreadOptions& format_opts = {});
 
     // add a log task to the queue
     template <LogLevel Level, typename... Args>
@@ -82,10 +284,44 @@ class MTLogger : public LoggerBase, public Singleton<MTLogger> {
                 auto logLine = fmt::format("[{}][{}][{}][{}:{}]: {}\n", *(size_t*)&pid,
                                            time(NULL), levelToString<Level>(), filename,
                                            line, fmt::format(format, std::move(args)...));
-                sink_->log(logLine);
+                emit(logLine, Level);
+            });
+    }
+
+    // add a structured record: msg must be a string literal, followed by key/value
+    // pairs whose keys are string literals. Values are encoded on the consumer; string
+    // values are copied first.
+    template <LogLevel Level, typename... KVs>
+    void logKV(const char* filename, int line, const char* msg, KVs&&... kvs) {
+        static_assert(sizeof...(KVs) % 2 == 0, "key/value arguments must come in pairs");
+        if (Level < level_) return;
+
+        if (stop_) return;
+
+        taskQueue_.emplace(
+            [kvs = captureKVs(std::forward<KVs>(kvs)...), filename, line, msg, this]() {
+                auto pid = std::this_thread::get_id();
+                KVHeader hdr{time(NULL), levelToString<Level>(), filename, line, msg,
+                             *(size_t*)&pid};
+                auto& kvLine = LoggerBase::kvLine();
+                encodeKV(*kvEncoder_, kvLine, hdr, kvs);
+                emit(kvLine, Level);
             });
     }
 
+    // Log and return a future completed once the record is on stable storage
+    template <LogLevel Level, typename... Args>
+    SyncFuture logDurable(const char* filename, int line, const std::string& format,
+                          Args&&... args) {
+        log<Level>(filename, line, format, std::forward<Args>(args)...);
+        return syncPoint();
+    }
+
+    // Future completed once everything logged before it is on stable storage
+    SyncFuture syncPoint();
+    // Same, but cb(ok) is called on the consumer thread; cb must not log
+    void syncPoint(SyncCallback cb);
+
     void stop();
 
    protected:
@@ -95,8 +331,15 @@ class MTLogger : public LoggerBase, public Singleton<MTLogger> {
     void processLogTasks();
 
     std::mutex mutex_;
-    MPMCQueue<std::function<void()>> taskQueue_;
+#ifdef SHLOG_SEGMENTED_QUEUE
+    SegmentedQueue<LogTask> taskQueue_{SHLOG_QUEUE_MEMORY_LIMIT};
+#else
+    MPMCQueue<LogTask, 65536, LogTaskAllocator> taskQueue_;
+#endif
     std::thread processThread_;
+    std::unique_ptr<FormatStage> formatStage_;
+    std::vector<std::thread> formatThreads_;
+    std::mutex syncMutex_;  // orders syncPoint against stop
     std::atomic<bool> stop_;
 };
 
@@ -106,8 +349,12 @@ class STLogger : public LoggerBase, public Singleton<STLogger> {
    public:
     ~STLogger();
 
-    // Initialize logger with output file
-    void init(LogLevel level = LogLevel::INFO, SinkPtr = std::make_unique<ConsoleSink>());
+    // Initialize logger with output sink; thread_opts places the consumer thread.
+    // With format_threads > 0, that many threads, placed by format_opts, format
+    // records in parallel and the consumer only writes them, in enqueue order.
+    void init(LogLevel level = LogLevel::INFO, SinkPtr = std::make_unique<ConsoleSink>(),
+              const ThreadOptions& thread_opts = {}, size_t format_threads = 0,
+              const ThreadOptions& format_opts = {});
 
     // add a log task to the queue
     template <LogLevel Level, typename... Args>
@@ -121,10 +368,42 @@ class STLogger : public LoggerBase, public Singleton<STLogger> {
             auto logLine =
                 fmt::format("[{}][{}][{}:{}]: {}\n", time(NULL), levelToString<Level>(),
                             filename, line, fmt::format(format, std::move(args)...));
-            sink_->log(logLine);
+            emit(logLine, Level);
         });
     }
 
+    // add a structured record: msg must be a string literal, followed by key/value
+    // pairs whose keys are string literals. Values are encoded on the consumer; string
+    // values are copied first.
+    template <LogLevel Level, typename... KVs>
+    void logKV(const char* filename, int line, const char* msg, KVs&&... kvs) {
+        static_assert(sizeof...(KVs) % 2 == 0, "key/value arguments must come in pairs");
+        if (Level < level_) return;
+
+        if (stop_) return;
+
+        taskQueue_.emplace(
+            [kvs = captureKVs(std::forward<KVs>(kvs)...), filename, line, msg, this]() {
+                KVHeader hdr{time(NULL), levelToString<Level>(), filename, line, msg};
+                auto& kvLine = LoggerBase::kvLine();
+                encodeKV(*kvEncoder_, kvLine, hdr, kvs);
+                emit(kvLine, Level);
+            });
+    }
+
+    // Log and return a future completed once the record is on stable storage
+    template <LogLevel Level, typename... Args>
+    SyncFuture logDurable(const char* filename, int line, const std::string& format,
+                          Args&&... args) {
+        log<Level>(filename, line, format, std::forward<Args>(args)...);
+        return syncPoint();
+    }
+
+    // Future completed once everything logged before it is on stable storage
+    SyncFuture syncPoint();
+    // Same, but cb(ok) is called on the consumer thread; cb must not log
+    void syncPoint(SyncCallback cb);
+
     void stop();
 
    protected:
@@ -133,16 +412,223 @@ class STLogger : public LoggerBase, public Singleton<STLogger> {
     // Process log tasks
     void processLogTasks();
 
-    SPSCQueue<std::function<void()>> taskQueue_;
+#ifdef SHLOG_SEGMENTED_QUEUE
+    SegmentedQueue<LogTask> taskQueue_{SHLOG_QUEUE_MEMORY_LIMIT};
+#else
+    SPSCQueue<LogTask, 65536, LogTaskAllocator> taskQueue_;
+#endif
     std::thread processThread_;
-    bool stop_;
+    std::unique_ptr<FormatStage> formatStage_;
+    std::vector<std::thread> formatThreads_;
+    std::mutex syncMutex_;  // orders syncPoint against stop
+    std::atomic<bool> stop_;
 };
 
-using DefaultLogger = STLogger;
+// Logger for hosts running many processes: callers format in place and append to
+// this process's shared-memory ring. No consumer thread runs in the process; one
+// shlog_collectord per host drains every ring to its sinks, including the records
+// of processes that crashed. Records are dropped (and counted) if the ring is full.
+class ShmLogger : public LoggerBase, public Singleton<ShmLogger> {
+    friend class Singleton<ShmLogger>;
+
+   public:
+    ~ShmLogger();
+
+    // Initialize logger with a ring of ring_bytes (a power of two) named after prefix.
+    // Once per process: the ring stays mapped until exit, even after stop().
+    void init(LogLevel level = LogLevel::INFO, size_t ring_bytes = ShmRing::kDefaultCapacity,
+              const std::string& prefix = ShmRing::kDefaultPrefix);
+
+    // format the record and append it to the ring
+    template <LogLevel Level, typename... Args>
+    void log(const char* filename, int line, const std::string& format, Args&&... args) {
+        if (Level < level_) return;
+
+        if (stop_) return;
 
+        thread_local fmt::memory_buffer buf;
+        buf.clear();
+        fmt::format_to(std::back_inserter(buf), "[{}][{}][{}][{}:{}]: ", pid_, time(NULL),
+                       levelToString<Level>(), filename, line);
+        fmt::format_to(std::back_inserter(buf), format, std::forward<Args>(args)...);
+        buf.push_back('\n');
+        ring_.write(buf.data(), buf.size());
+    }
+
+    // encode the structured record and append it to the ring
+    template <LogLevel Level, typename... KVs>
+    void logKV(const char* filename, int line, const char* msg, KVs&&... kvs) {
+        static_assert(sizeof...(KVs) % 2 == 0, "key/value arguments must come in pairs");
+        if (Level < level_) return;
+
+        if (stop_) return;
+
+        thread_local LogMessage buf;
+        KVHeader hdr{time(NULL), levelToString<Level>(), filename, line, msg, 0, pid_};
+        encodeKV(*kvEncoder_, buf, hdr, std::forward_as_tuple(kvs...));
+        ring_.write(buf.data(), buf.size());
+    }
+
+    void stop();
+
+   protected:
+    ShmLogger();
+
+    std::mutex mutex_;
+    ShmRing ring_;
+    int pid_;
+    std::atomic<bool> stop_;
+};
+
+// Named logger: any number of them can be created (getLogger), each with its own
+// level, sink and task queue. Their queues are drained by a shared pool of consumer
+// threads (setConsumerThreads) instead of one thread per logger.
+class Logger : public LoggerBase {
+   public:
+    // Set level and sink. The sink is swapped on the consumer, after the records
+    // queued so far, so init may be called while others are logging.
+    void init(LogLevel level = LogLevel::INFO,
+              SinkPtr sink = std::make_unique<ConsoleSink>());
+    // Replace the sink on the consumer, after the records queued so far (nullptr:
+    // back to the console). Hides LoggerBase::setLogSink, which would swap it under
+    // the pool thread.
+    void setLogSink(SinkPtr sink);
+
+    // add a log task to the queue
+    template <LogLevel Level, typename... Args>
+    void log(const char* filename, int line, const std::string& format, Args&&... args) {
+        if (Level < level_) return;
+
+        taskQueue_.emplace(
+            [... args = std::forward<Args>(args), filename, line, format, this]() mutable {
+                auto pid = std::this_thread::get_id();
+                auto logLine = fmt::format(
+                    "[{}][{}][{}][{}][{}:{}]: {}\n", *(size_t*)&pid, time(NULL),
+                    levelToString<Level>(), name_, filename, line,
+                    fmt::format(format, std::move(args)...));
+                emit(logLine, Level);
+            });
+    }
+
+    // add a structured record, see MTLogger::logKV
+    template <LogLevel Level, typename... KVs>
+    void logKV(const char* filename, int line, const char* msg, KVs&&... kvs) {
+        static_assert(sizeof...(KVs) % 2 == 0, "key/value arguments must come in pairs");
+        if (Level < level_) return;
+
+        taskQueue_.emplace(
+            [kvs = captureKVs(std::forward<KVs>(kvs)...), filename, line, msg, this]() {
+                auto pid = std::this_thread::get_id();
+                KVHeader hdr{time(NULL), levelToString<Level>(), filename, line, msg,
+                             *(size_t*)&pid, 0, name_};
+                auto& kvLine = LoggerBase::kvLine();
+                encodeKV(*kvEncoder_, kvLine, hdr, kvs);
+                emit(kvLine, Level);
+            });
+    }
+
+    // Log and return a future completed once the record is on stable storage
+    template <LogLevel Level, typename... Args>
+    SyncFuture logDurable(const char* filename, int line, const std::string& format,
+                          Args&&... args) {
+        log<Level>(filename, line, format, std::forward<Args>(args)...);
+        return syncPoint();
+    }
+
+    // Future completed once everything logged before it is on stable storage
+    SyncFuture syncPoint();
+    // Same, but cb(ok) is called on the consumer thread; cb must not log
+    void syncPoint(SyncCallback cb);
+
+    const std::string& name() const { return name_; }
+
+   protected:
+    friend class LoggerRegistry;
+
+    explicit Logger(std::string name);
+
+    // Run up to kTaskBatch queued tasks; called by the one pool thread serving this
+    // logger. Returns the number of tasks run.
+    size_t processLogTasks(LogTask* tasks);
+
+    std::string name_;
+#ifdef SHLOG_SEGMENTED_QUEUE
+    SegmentedQueue<LogTask> taskQueue_{SHLOG_QUEUE_MEMORY_LIMIT};
+#else
+    MPMCQueue<LogTask, 8192, LogTaskAllocator> taskQueue_;
 #endif
+};
+
+// Owns the named loggers and the consumer pool. Lookups by name are lock-free: an
+// open-addressing table of atomic pointers that is only ever inserted into; creating
+// a logger or resizing the pool takes a mutex.
+class LoggerRegistry : public Singleton<LoggerRegistry> {
+    friend class Singleton<LoggerRegistry>;
+
+   public:
+    static constexpr size_t kMaxLoggers = 256;
+
+    ~LoggerRegistry();
+
+    // The logger called name, created on first use (level NONE until init)
+    Logger& get(std::string_view name);
+
+    // Number and placement of the consumer threads shared by all named loggers; the
+    // pool is drained and restarted. Logger i is served by thread i % threads.
+    void setConsumerThreads(size_t threads, const ThreadOptions& thread_opts = {});
+
+   protected:
+    LoggerRegistry() = default;
+
+    void start();
+    void stop();
+    void consume(size_t index, size_t threads);
+
+    static constexpr size_t kTableSize = 2 * kMaxLoggers;
+    // Idle rounds a consumer spins before it starts sleeping between rounds
+    static constexpr size_t kSpinRounds = 64;
+    static constexpr std::chrono::microseconds kIdleSleep{100};
+
+    std::atomic<Logger*> table_[kTableSize]{};
+    std::atomic<Logger*> loggers_[kMaxLoggers]{};  // in creation order
+    std::atomic<size_t> count_{0};
+
+    std::mutex mutex_;
+    std::vector<std::thread> threads_;
+    size_t threadCount_{1};
+    ThreadOptions threadOpts_;
+    std::atomic<bool> stop_{false};
+};
+
+// Named logger, created on first use
+inline Logger& getLogger(std::string_view name) {
+    return LoggerRegistry::GetInst().get(name);
+}
+
+// Size and place the consumer pool shared by the named loggers
+inline void setConsumerThreads(size_t threads, const ThreadOptions& thread_opts = {}) {
+    LoggerRegistry::GetInst().setConsumerThreads(threads, thread_opts);
 }
 
+template <size_t N>
+struct LoggerName {
+    constexpr LoggerName(const char (&name)[N]) { std::copy_n(name, N, value); }
+    char value[N];
+};
+
+// Handle of a named logger for the SHLOG_LOGGER_* macros, which resolves the name
+// once and caches the logger: SHLOG_LOGGER_INFO(shlog::NamedLogger<"net">, ...).
+template <LoggerName Name>
+struct NamedLogger {
+    static Logger& GetInst() {
+        static Logger& logger = getLogger(Name.value);
+        return logger;
+    }
+};
+
+using DefaultLogger = STLogger;
+}  // namespace shlog
+
 #define SHLOG_INIT(level, ...) shlog::DefaultLogger::GetInst().init(level, ##__VA_ARGS__)
 #define SHLOG_LOGGER_INIT(logger, level, ...) logger::GetInst().init(level, ##__VA_ARGS__)
 
@@ -187,3 +673,55 @@ using DefaultLogger = STLogger;
 #define SHLOG_LOGGER_FATAL(logger, format, ...)                                    \
     logger::GetInst().log<shlog::LogLevel::FATAL>(__FILE__, __LINE__, format, \
                                                   ##__VA_ARGS__)
+
+// Durable records: auto done = SHLOG_DURABLE(shlog::LogLevel::WARN, "fill {}", id)
+#define SHLOG_DURABLE(level, format, ...)                                     \
+    shlog::DefaultLogger::GetInst().logDurable<level>(__FILE__, __LINE__, format, \
+                                                      ##__VA_ARGS__)
+#define SHLOG_LOGGER_DURABLE(logger, level, format, ...) \
+    logger::GetInst().logDurable<level>(__FILE__, __LINE__, format, ##__VA_ARGS__)
+
+// Structured records: SHLOG_INFO_KV("order filled", "id", id, "px", px)
+#define SHLOG_TRACE_KV(msg, ...)                                                      \
+    shlog::DefaultLogger::GetInst().logKV<shlog::LogLevel::TRACE>(__FILE__, __LINE__, \
+                                                                "" msg, ##__VA_ARGS__)
+#define SHLOG_LOGGER_TRACE_KV(logger, msg, ...)                                 \
+    logger::GetInst().logKV<shlog::LogLevel::TRACE>(__FILE__, __LINE__, "" msg, \
+                                                  ##__VA_ARGS__)
+
+#define SHLOG_DEBUG_KV(msg, ...)                                                      \
+    shlog::DefaultLogger::GetInst().logKV<shlog::LogLevel::DEBUG>(__FILE__, __LINE__, \
+                                                                "" msg, ##__VA_ARGS__)
+#define SHLOG_LOGGER_DEBUG_KV(logger, msg, ...)                                 \
+    logger::GetInst().logKV<shlog::LogLevel::DEBUG>(__FILE__, __LINE__, "" msg, \
+                                                  ##__VA_ARGS__)
+
+#define SHLOG_INFO_KV(msg, ...)                                                      \
+    shlog::DefaultLogger::GetInst().logKV<shlog::LogLevel::INFO>(__FILE__, __LINE__, \
+                                                                "" msg, ##__VA_ARGS__)
+#define SHLOG_LOGGER_INFO_KV(logger, msg, ...)                                 \
+    logger::GetInst().logKV<shlog::LogLevel::INFO>(__FILE__, __LINE__, "" msg, \
+                                                  ##__VA_ARGS__)
+
+#define SHLOG_WARN_KV(msg, ...)                                                      \
+    shlog::DefaultLogger::GetInst().logKV<shlog::LogLevel::WARN>(__FILE__, __LINE__, \
+                                                                "" msg, ##__VA_ARGS__)
+#define SHLOG_LOGGER_WARN_KV(logger, msg, ...)                                 \
+    logger::GetInst().logKV<shlog::LogLevel::WARN>(__FILE__, __LINE__, "" msg, \
+                                                  ##__VA_ARGS__)
+
+#define SHLOG_ERROR_KV(msg, ...)                                                      \
+    shlog::DefaultLogger::GetInst().logKV<shlog::LogLevel::ERROR>(__FILE__, __LINE__, \
+                                                                "" msg, ##__VA_ARGS__)
+#define SHLOG_LOGGER_ERROR_KV(logger, msg, ...)                                 \
+    logger::GetInst().logKV<shlog::LogLevel::ERROR>(__FILE__, __LINE__, "" msg, \
+                                                  ##__VA_ARGS__)
+
+#define SHLOG_FATAL_KV(msg, ...)                                                      \
+    shlog::DefaultLogger::GetInst().logKV<shlog::LogLevel::FATAL>(__FILE__, __LINE__, \
+                                                                "" msg, ##__VA_ARGS__)
+#define SHLOG_LOGGER_FATAL_KV(logger, msg, ...)                                 \
+    logger::GetInst().logKV<shlog::LogLevel::FATAL>(__FILE__, __LINE__, "" msg, \
+                                                  ##__VA_ARGS__)
+
+#endif  // _LOGGER_H
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+
+#include "libs/shm_ring.h"
+#include "log_sink.h"
+
+namespace shlog {
+
+// Drains the shared-memory rings of the ShmLogger processes on the host into one
+// sink; rings are found under /dev/shm by name prefix. Used by shlog_collectord.
+class ShmCollector {
+   public:
+    explicit ShmCollector(SinkPtr sink, std::string prefix = ShmRing::kDefaultPrefix);
+
+    // Attach rings created since the last scan.
+    void scan();
+    // Drain every ring once; rings whose producer is gone are recovered and removed.
+    // Returns the number of records written to the sink.
+    size_t poll();
+    void flush() { sink_->flush(); }
+
+    size_t rings() const { return rings_.size(); }
+
+   private:
+    SinkPtr sink_;
+    std::string prefix_;
+    std::map<std::string, std::unique_ptr<ShmRing>> rings_;
+};
+
+}  // namespace shlog
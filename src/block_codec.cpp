@@ -0,0 +1,90 @@
+#include "shlog/libs/block_codec.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#ifdef SHLOG_LZ4
+#include <lz4.h>
+#endif
+#ifdef SHLOG_ZSTD
+#include <zstd.h>
+#endif
+
+namespace shlog {
+bool codec_available(Codec codec) {
+    switch (codec) {
+        case Codec::NONE:
+            return true;
+#ifdef SHLOG_LZ4
+        case Codec::LZ4:
+            return true;
+#endif
+#ifdef SHLOG_ZSTD
+        case Codec::ZSTD:
+            return true;
+#endif
+        default:
+            return false;
+    }
+}
+
+size_t compress_bound(Codec codec, size_t len) {
+    switch (codec) {
+#ifdef SHLOG_LZ4
+        case Codec::LZ4:
+            return LZ4_compressBound(static_cast<int>(len));
+#endif
+#ifdef SHLOG_ZSTD
+        case Codec::ZSTD:
+            return ZSTD_compressBound(len);
+#endif
+        default:
+            return len;
+    }
+}
+
+size_t compress(Codec codec, const char* src, size_t len, char* dst, size_t cap,
+                [[maybe_unused]] int level) {
+    switch (codec) {
+        case Codec::NONE:
+            if (cap < len) return 0;
+            std::copy(src, src + len, dst);
+            return len;
+#ifdef SHLOG_LZ4
+        case Codec::LZ4: {
+            int n = level > 1 ? LZ4_compress_fast(src, dst, len, cap, level)
+                              : LZ4_compress_default(src, dst, len, cap);
+            return n > 0 ? n : 0;
+        }
+#endif
+#ifdef SHLOG_ZSTD
+        case Codec::ZSTD: {
+            size_t n = ZSTD_compress(dst, cap, src, len, level != 0 ? level : 1);
+            return ZSTD_isError(n) ? 0 : n;
+        }
+#endif
+        default:
+            throw std::invalid_argument("codec not compiled in");
+    }
+}
+
+bool decompress(Codec codec, const char* src, size_t len, char* dst, size_t raw_len) {
+    switch (codec) {
+        case Codec::NONE:
+            if (len != raw_len) return false;
+            std::copy(src, src + len, dst);
+            return true;
+#ifdef SHLOG_LZ4
+        case Codec::LZ4:
+            return LZ4_decompress_safe(src, dst, len, raw_len) ==
+                   static_cast<int>(raw_len);
+#endif
+#ifdef SHLOG_ZSTD
+        case Codec::ZSTD:
+            return ZSTD_decompress(dst, raw_len, src, len) == raw_len;
+#endif
+        default:
+            return false;
+    }
+}
+}  // namespace shlog
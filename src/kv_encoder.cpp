@@ -0,0 +1,264 @@
+#include "shlog/kv_encoder.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <cmath>
+
+namespace shlog {
+namespace {
+// Whether c must be escaped in a JSON string, or (Logfmt) forces quoting of a value.
+template <bool Logfmt>
+bool isSpecial(unsigned char c) {
+    if (c < 0x20 || c == '"' || c == '\\') return true;
+    return Logfmt && (c == ' ' || c == '=');
+}
+
+// Index of the first special character of s, or s.size(). Checks 16 bytes per step
+// where SSE2 is available: log values are mostly clean, long runs.
+template <bool Logfmt>
+size_t findSpecial(std::string_view s, size_t pos = 0) {
+    const char* p = s.data();
+    size_t n = s.size();
+#ifdef __SSE2__
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i equal = _mm_set1_epi8('=');
+    const __m128i ctl = _mm_set1_epi8(0x1f);
+    for (; pos + 16 <= n; pos += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + pos));
+        // unsigned v <= 0x1f  <=>  max(v, 0x1f) == 0x1f
+        __m128i m = _mm_cmpeq_epi8(_mm_max_epu8(v, ctl), ctl);
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(v, quote));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(v, backslash));
+        if constexpr (Logfmt) {
+            m = _mm_or_si128(m, _mm_cmpeq_epi8(v, space));
+            m = _mm_or_si128(m, _mm_cmpeq_epi8(v, equal));
+        }
+        int mask = _mm_movemask_epi8(m);
+        if (mask != 0) {
+            return pos + __builtin_ctz(mask);
+        }
+    }
+#endif
+    for (; pos < n; ++pos) {
+        if (isSpecial<Logfmt>(p[pos])) return pos;
+    }
+    return n;
+}
+
+void appendInt(std::string& out, auto value) {
+    fmt::format_int s(value);
+    out.append(s.data(), s.size());
+}
+
+void appendDouble(std::string& out, double value) {
+    fmt::format_to(std::back_inserter(out), "{}", value);
+}
+}  // namespace
+
+void escapeJSON(std::string& out, std::string_view s) {
+    static constexpr char kHex[] = "0123456789abcdef";
+    size_t pos = 0;
+    while (true) {
+        size_t next = findSpecial<false>(s, pos);
+        out.append(s.data() + pos, next - pos);
+        if (next == s.size()) return;
+
+        unsigned char c = s[next];
+        switch (c) {
+            case '"':
+                out.append("\\\"");
+                break;
+            case '\\':
+                out.append("\\\\");
+                break;
+            case '\n':
+                out.append("\\n");
+                break;
+            case '\r':
+                out.append("\\r");
+                break;
+            case '\t':
+                out.append("\\t");
+                break;
+            case '\b':
+                out.append("\\b");
+                break;
+            case '\f':
+                out.append("\\f");
+                break;
+            default:
+                out.append("\\u00");
+                out.push_back(kHex[c >> 4]);
+                out.push_back(kHex[c & 0xf]);
+        }
+        pos = next + 1;
+    }
+}
+
+void escapeLogfmt(std::string& out, std::string_view s) {
+    if (!s.empty() && findSpecial<true>(s) == s.size()) {
+        out.append(s);
+        return;
+    }
+    out.push_back('"');
+    escapeJSON(out, s);
+    out.push_back('"');
+}
+
+// *******************************
+
+void JSONEncoder::begin(std::string& out, const KVHeader& hdr) const {
+    out.append("{\"time\":");
+    appendInt(out, static_cast<int64_t>(hdr.time));
+    if (hdr.pid != 0) {
+        out.append(",\"pid\":");
+        appendInt(out, hdr.pid);
+    }
+    if (hdr.thread != 0) {
+        out.append(",\"thread\":");
+        appendInt(out, hdr.thread);
+    }
+    out.append(",\"level\":\"");
+    out.append(hdr.level);
+    if (!hdr.logger.empty()) {
+        out.append("\",\"logger\":\"");
+        escapeJSON(out, hdr.logger);
+    }
+    out.append("\",\"file\":\"");
+    escapeJSON(out, hdr.file);
+    out.append("\",\"line\":");
+    appendInt(out, hdr.line);
+    out.append(",\"msg\":\"");
+    escapeJSON(out, hdr.msg);
+    out.push_back('"');
+}
+
+void JSONEncoder::key(std::string& out, std::string_view key) const {
+    out.append(",\"");
+    escapeJSON(out, key);
+    out.append("\":");
+}
+
+void JSONEncoder::fieldString(std::string& out, std::string_view key,
+                              std::string_view value) const {
+    this->key(out, key);
+    out.push_back('"');
+    escapeJSON(out, value);
+    out.push_back('"');
+}
+
+void JSONEncoder::fieldInt(std::string& out, std::string_view key, int64_t value) const {
+    this->key(out, key);
+    appendInt(out, value);
+}
+
+void JSONEncoder::fieldUint(std::string& out, std::string_view key, uint64_t value) const {
+    this->key(out, key);
+    appendInt(out, value);
+}
+
+void JSONEncoder::fieldDouble(std::string& out, std::string_view key, double value) const {
+    this->key(out, key);
+    // JSON has no NaN / Infinity
+    if (std::isfinite(value)) {
+        appendDouble(out, value);
+    } else {
+        out.append("null");
+    }
+}
+
+void JSONEncoder::fieldBool(std::string& out, std::string_view key, bool value) const {
+    this->key(out, key);
+    out.append(value ? "true" : "false");
+}
+
+void JSONEncoder::end(std::string& out) const { out.append("}\n"); }
+
+// *******************************
+
+void LogfmtEncoder::begin(std::string& out, const KVHeader& hdr) const {
+    out.append("time=");
+    appendInt(out, static_cast<int64_t>(hdr.time));
+    if (hdr.pid != 0) {
+        out.append(" pid=");
+        appendInt(out, hdr.pid);
+    }
+    if (hdr.thread != 0) {
+        out.append(" thread=");
+        appendInt(out, hdr.thread);
+    }
+    out.append(" level=");
+    out.append(hdr.level);
+    if (!hdr.logger.empty()) {
+        out.append(" logger=");
+        escapeLogfmt(out, hdr.logger);
+    }
+    out.append(" file=");
+    escapeLogfmt(out, hdr.file);
+    out.append(" line=");
+    appendInt(out, hdr.line);
+    out.append(" msg=");
+    escapeLogfmt(out, hdr.msg);
+}
+
+void LogfmtEncoder::fieldString(std::string& out, std::string_view key,
+                                std::string_view value) const {
+    out.push_back(' ');
+    out.append(key);
+    out.push_back('=');
+    escapeLogfmt(out, value);
+}
+
+void LogfmtEncoder::fieldInt(std::string& out, std::string_view key, int64_t value) const {
+    out.push_back(' ');
+    out.append(key);
+    out.push_back('=');
+    appendInt(out, value);
+}
+
+void LogfmtEncoder::fieldUint(std::string& out, std::string_view key,
+                              uint64_t value) const {
+    out.push_back(' ');
+    out.append(key);
+    out.push_back('=');
+    appendInt(out, value);
+}
+
+void LogfmtEncoder::fieldDouble(std::string& out, std::string_view key,
+                                double value) const {
+    out.push_back(' ');
+    out.append(key);
+    out.push_back('=');
+    appendDouble(out, value);
+}
+
+void LogfmtEncoder::fieldBool(std::string& out, std::string_view key, bool value) const {
+    out.push_back(' ');
+    out.append(key);
+    out.push_back('=');
+    out.append(value ? "true" : "false");
+}
+
+void LogfmtEncoder::end(std::string& out) const { out.push_back('\n'); }
+
+// *******************************
+
+void TextEncoder::begin(std::string& out, const KVHeader& hdr) const {
+    if (hdr.pid != 0) {
+        fmt::format_to(std::back_inserter(out), "[{}]", hdr.pid);
+    }
+    if (hdr.thread != 0) {
+        fmt::format_to(std::back_inserter(out), "[{}]", hdr.thread);
+    }
+    fmt::format_to(std::back_inserter(out), "[{}][{}]", hdr.time, hdr.level);
+    if (!hdr.logger.empty()) {
+        fmt::format_to(std::back_inserter(out), "[{}]", hdr.logger);
+    }
+    fmt::format_to(std::back_inserter(out), "[{}:{}]: {}", hdr.file, hdr.line, hdr.msg);
+}
+
+}  // namespace shlog
@@ -0,0 +1,146 @@
+#include "shlog/log_reader.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <system_error>
+
+namespace shlog {
+namespace {
+int64_t toNanos(CompressedLogReader::TimePoint tp) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(tp.time_since_epoch())
+        .count();
+}
+}  // namespace
+
+CompressedLogReader::CompressedLogReader(const std::string& path) {
+    fd_ = ::open(path.c_str(), O_RDONLY);
+    if (fd_ < 0) {
+        throw std::system_error(errno, std::system_category(), "failed to open file");
+    }
+    struct stat st;
+    if (fstat(fd_, &st) != 0) {
+        int err = errno;
+        ::close(fd_);
+        throw std::system_error(err, std::system_category(), "failed to stat file");
+    }
+    end_ = st.st_size;
+
+    int ifd = ::open((path + kIndexSuffix).c_str(), O_RDONLY);
+    if (ifd >= 0) {
+        struct stat ist;
+        if (fstat(ifd, &ist) == 0) {
+            blocks_.resize(ist.st_size / sizeof(IndexEntry));
+            ssize_t len = blocks_.size() * sizeof(IndexEntry);
+            if (::pread(ifd, blocks_.data(), len, 0) != len) {
+                blocks_.clear();
+            }
+        }
+        ::close(ifd);
+    }
+
+    // the index is written after its block: drop entries that point past the data
+    BlockHeader hdr;
+    while (!blocks_.empty() && !readHeader(blocks_.back().offset, hdr)) {
+        blocks_.pop_back();
+    }
+
+    off_t off = 0;
+    if (!blocks_.empty()) {
+        off = blocks_.back().offset + sizeof(BlockHeader) + hdr.size;
+        next_seq_ = hdr.first_seq + hdr.count;
+    }
+    while (readHeader(off, hdr)) {
+        blocks_.push_back({static_cast<uint64_t>(off), hdr.first_seq, hdr.first_ts,
+                           hdr.last_ts});
+        off += sizeof(BlockHeader) + hdr.size;
+        next_seq_ = hdr.first_seq + hdr.count;
+        stale_ = true;
+    }
+    end_ = off;
+}
+
+CompressedLogReader::~CompressedLogReader() {
+    if (fd_ != -1) {
+        ::close(fd_);
+    }
+}
+
+size_t CompressedLogReader::read(TimePoint from, TimePoint to, const RecordCallback& fn) {
+    int64_t lo = toNanos(from);
+    int64_t hi = toNanos(to);
+    size_t cnt = 0;
+    // the index is small: a linear scan also copes with wall clock steps
+    for (size_t i = 0; i < blocks_.size(); ++i) {
+        if (blocks_[i].last_ts >= lo && blocks_[i].first_ts <= hi) {
+            cnt += readBlock(i, 0, std::numeric_limits<uint64_t>::max(), fn);
+        }
+    }
+    return cnt;
+}
+
+size_t CompressedLogReader::readSeq(uint64_t first, uint64_t last,
+                                    const RecordCallback& fn) {
+    auto it = std::upper_bound(
+        blocks_.begin(), blocks_.end(), first,
+        [](uint64_t seq, const IndexEntry& e) { return seq < e.first_seq; });
+    size_t i = it == blocks_.begin() ? 0 : it - blocks_.begin() - 1;
+
+    size_t cnt = 0;
+    for (; i < blocks_.size() && blocks_[i].first_seq <= last; ++i) {
+        cnt += readBlock(i, first, last, fn);
+    }
+    return cnt;
+}
+
+size_t CompressedLogReader::readAll(const RecordCallback& fn) {
+    return readSeq(0, std::numeric_limits<uint64_t>::max(), fn);
+}
+
+bool CompressedLogReader::readHeader(off_t offset, BlockHeader& hdr) {
+    if (offset + static_cast<off_t>(sizeof(BlockHeader)) > end_) return false;
+    if (::pread(fd_, &hdr, sizeof(hdr), offset) != sizeof(hdr)) return false;
+    return hdr.magic == kBlockMagic && hdr.codec <= static_cast<uint8_t>(Codec::ZSTD) &&
+           offset + static_cast<off_t>(sizeof(BlockHeader) + hdr.size) <= end_;
+}
+
+size_t CompressedLogReader::readBlock(size_t i, uint64_t first, uint64_t last,
+                                      const RecordCallback& fn) {
+    BlockHeader hdr;
+    off_t off = blocks_[i].offset;
+    if (!readHeader(off, hdr)) return 0;
+
+    buf_.resize(hdr.size);
+    raw_.resize(hdr.raw_size);
+    if (::pread(fd_, buf_.data(), hdr.size, off + sizeof(BlockHeader)) !=
+            static_cast<ssize_t>(hdr.size) ||
+        !decompress(static_cast<Codec>(hdr.codec), buf_.data(), hdr.size, raw_.data(),
+                    hdr.raw_size)) {
+        std::cerr << "skipping corrupt log block at offset " << off << std::endl;
+        return 0;
+    }
+
+    size_t cnt = 0;
+    size_t pos = 0;
+    for (uint32_t k = 0; k < hdr.count && pos + sizeof(uint32_t) <= raw_.size(); ++k) {
+        uint32_t len;
+        memcpy(&len, raw_.data() + pos, sizeof(len));
+        pos += sizeof(len);
+        if (pos + len > raw_.size()) break;
+
+        uint64_t seq = hdr.first_seq + k;
+        if (seq >= first && seq <= last) {
+            fn(seq, std::string_view(raw_.data() + pos, len));
+            ++cnt;
+        }
+        pos += len;
+    }
+    return cnt;
+}
+
+}  // namespace shlog
@@ -1,16 +1,123 @@
 #include "shlog/log_sink.h"
 
 #include <fcntl.h>
+#include <poll.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <chrono>
 #include <cstring>
 #include <ctime>
 #include <iomanip>
 #include <sstream>
 #include <system_error>
+#include <thread>
+
+#include "shlog/log_reader.h"
 
 namespace shlog {
+namespace {
+int64_t nowNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+// Write all of iov, waiting while a non-blocking fd is full. False on errors such
+// as EPIPE; the rest of the data is dropped then.
+bool writeAll(int fd, iovec* iov, int cnt) {
+    while (cnt > 0) {
+        ssize_t n = ::writev(fd, iov, cnt);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                pollfd pfd{fd, POLLOUT, 0};
+                ::poll(&pfd, 1, -1);
+                continue;
+            }
+            return false;
+        }
+        while (cnt > 0 && static_cast<size_t>(n) >= iov->iov_len) {
+            n -= iov->iov_len;
+            ++iov;
+            --cnt;
+        }
+        if (cnt > 0) {
+            iov->iov_base = static_cast<char*>(iov->iov_base) + n;
+            iov->iov_len -= n;
+        }
+    }
+    return true;
+}
+
+// State behind SharedUring::global()
+struct GlobalUring {
+    std::mutex mutex;
+    std::weak_ptr<SharedUring> ring;
+    UringOptions opts;
+};
+
+GlobalUring& globalUring() {
+    static GlobalUring g;
+    return g;
+}
+
+const char* levelColor(LogLevel level) {
+    switch (level) {
+        case LogLevel::TRACE:
+            return "\033[90m";
+        case LogLevel::DEBUG:
+            return "\033[36m";
+        case LogLevel::WARN:
+            return "\033[33m";
+        case LogLevel::ERROR:
+            return "\033[31m";
+        case LogLevel::FATAL:
+            return "\033[1;31m";
+        default:
+            return nullptr;
+    }
+}
+}  // namespace
+
+void LogSinkBase::commit() {
+    poll();
+    if (waiters_.empty()) {
+        if (unsynced_ == 0) return;
+        bool due = policy_.bytes > 0 && unsynced_ >= policy_.bytes;
+        if (!due && policy_.interval.count() > 0) {
+            due = std::chrono::steady_clock::now() - last_sync_ >= policy_.interval;
+        }
+        if (!due) return;
+    }
+
+    unsynced_ = 0;
+    last_sync_ = std::chrono::steady_clock::now();
+    // completions may be reaped by another sink's consumer on a shared ring
+    inflight_.fetch_add(1, std::memory_order_relaxed);
+    waiters_.push_back(
+        [this](bool) { inflight_.fetch_sub(1, std::memory_order_release); });
+    sync(std::move(waiters_));
+    waiters_.clear();
+}
+
+void LogSinkBase::drain() {
+    while (!waiters_.empty() || inflight_.load(std::memory_order_acquire) > 0) {
+        commit();
+        std::this_thread::yield();
+    }
+}
+
+void LogSinkBase::sync(std::vector<SyncCallback> waiters) {
+    flush();
+    for (auto& cb : waiters) {
+        cb(true);
+    }
+}
+
+// *******************************
+
 FileSinkBase::FileSinkBase(const std::string& file_path, bool append) {
     open(file_path, append);
 }
@@ -49,6 +156,15 @@ void FileSinkBase::close() {
     }
 }
 
+void FileSinkBase::truncate(off_t size) {
+    if (::ftruncate(fd_, size) != 0) {
+        std::cerr << "failed to truncate " << path_ << ": " << strerror(errno)
+                  << std::endl;
+        return;
+    }
+    offset_ = size;
+}
+
 std::string FileSinkBase::defaultFilePath() {
     auto now = std::chrono::system_clock::now();
     auto in_time_t = std::chrono::system_clock::to_time_t(now);
@@ -69,14 +185,449 @@ void StandardFileSink::flush() { ::fsync(fd_); }
 
 // *******************************
 
-UringFileSink::UringFileSink(const std::string& path, bool append)
-    : FileSinkBase(path, append) {
-    aio_.register_fds(&fd_, 1);
+SharedUring::SharedUring(const UringOptions& opts) : aio_(opts) {
+    if (!aio_.register_sparse(kMaxFiles)) {
+        throw std::runtime_error("failed to register io_uring file table");
+    }
+}
+
+std::shared_ptr<SharedUring> SharedUring::global() {
+    auto& g = globalUring();
+    std::lock_guard<std::mutex> lock(g.mutex);
+    auto ptr = g.ring.lock();
+    if (!ptr) {
+        ptr = std::make_shared<SharedUring>(g.opts);
+        g.ring = ptr;
+    }
+    return ptr;
+}
+
+bool SharedUring::configure(const UringOptions& opts) {
+    auto& g = globalUring();
+    std::lock_guard<std::mutex> lock(g.mutex);
+    if (!g.ring.expired()) return false;
+    g.opts = opts;
+    return true;
+}
+
+int SharedUring::attach(int fd) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    int index = aio_.add_fd(fd);
+    if (index < 0) {
+        throw std::runtime_error("no free slot in io_uring file table");
+    }
+    return index;
+}
+
+void SharedUring::detach(int index) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    aio_.remove_fd(index);
+}
+
+void SharedUring::write(LogMessage& msg, int index) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    aio_.write_async(msg, -1, index);
+}
+
+void SharedUring::write(const char* buf, size_t len, off_t offset, int index) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    aio_.write_async(buf, len, offset, index);
+    // a large buffer write: start it now, so it overlaps with filling the next one
+    aio_.submit();
+}
+
+void SharedUring::wait(int index) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    aio_.submit();
+    // block with the lock released, so the sinks of other threads keep using the
+    // ring; whoever holds it next may reap our completions, hence the short timeout
+    while (aio_.pending(index) > 0) {
+        lock.unlock();
+        pollfd pfd{aio_.ring_fd(), POLLIN, 0};
+        ::poll(&pfd, 1, 1);
+        lock.lock();
+    }
+}
+
+void SharedUring::fsync(int index, bool data_only) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        aio_.fsync_async(index, nullptr, data_only);
+    }
+    wait(index);
+}
+
+void SharedUring::fsyncAsync(int index, SyncCallback done) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    aio_.fsync_async(index, std::move(done), true);
+}
+
+void SharedUring::reap() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    aio_.reap();
+}
+
+// *******************************
+
+UringFileSink::UringFileSink(const std::string& path, bool append,
+                             std::shared_ptr<SharedUring> ring)
+    : FileSinkBase(path, append), ring_(std::move(ring)) {
+    index_ = ring_->attach(fd_);
+}
+
+UringFileSink::~UringFileSink() {
+    flush();
+    ring_->detach(index_);
+}
+
+void UringFileSink::log(LogMessage& msg) { ring_->write(msg, index_); }
+
+void UringFileSink::flush() { ring_->fsync(index_); }
+
+void UringFileSink::sync(std::vector<SyncCallback> waiters) {
+    // one fdatasync, ordered behind the queued writes, completes the whole group
+    ring_->fsyncAsync(index_, [waiters = std::move(waiters)](bool ok) {
+        for (auto& cb : waiters) {
+            cb(ok);
+        }
+    });
+}
+
+void UringFileSink::poll() { ring_->reap(); }
+
+// *******************************
+
+ConsoleSink::ConsoleSink(LogLevel stderr_level, bool color)
+    : out_(STDOUT_FILENO, color && isatty(STDOUT_FILENO) == 1),
+      err_(STDERR_FILENO, color && isatty(STDERR_FILENO) == 1),
+      stderr_level_(stderr_level) {
+    out_.buf.reserve(kBufferSize);
+    if (stderr_level_ != LogLevel::NONE) {
+        err_.buf.reserve(kBufferSize);
+    }
+}
+
+ConsoleSink::~ConsoleSink() { flush(); }
+
+void ConsoleSink::log(LogMessage& msg) { append(out_, msg, LogLevel::NONE); }
+
+void ConsoleSink::logWithLevel(LogMessage& msg, LogLevel level) {
+    append(level >= stderr_level_ ? err_ : out_, msg, level);
+}
+
+void ConsoleSink::flush() {
+    drain(out_);
+    drain(err_);
+}
+
+void ConsoleSink::poll() {
+    auto now = std::chrono::steady_clock::now();
+    for (Stream* s : {&out_, &err_}) {
+        if (!s->buf.empty() && now - s->since >= kFlushInterval) {
+            drain(*s);
+        }
+    }
+}
+
+void ConsoleSink::append(Stream& s, LogMessage& msg, LogLevel level) {
+    const char* color = s.color ? levelColor(level) : nullptr;
+    if (color == nullptr) {
+        if (s.buf.size() + msg.size() > kBufferSize) {
+            // no copy: the message goes out in the same writev as the buffer
+            drain(s, msg.data(), msg.size());
+            return;
+        }
+        if (s.buf.empty()) s.since = std::chrono::steady_clock::now();
+        s.buf.append(msg);
+        return;
+    }
+
+    static constexpr std::string_view reset = "\033[0m";
+    std::string_view body = msg;
+    bool newline = !body.empty() && body.back() == '\n';
+    if (newline) body.remove_suffix(1);
+
+    if (s.buf.size() + strlen(color) + body.size() + reset.size() + 1 > kBufferSize) {
+        drain(s);
+    }
+    if (s.buf.empty()) s.since = std::chrono::steady_clock::now();
+    s.buf.append(color);
+    s.buf.append(body);
+    s.buf.append(reset);
+    if (newline) s.buf.push_back('\n');
+}
+
+void ConsoleSink::drain(Stream& s, const char* extra, size_t extra_len) {
+    if (s.buf.empty() && extra_len == 0) return;
+    iovec iov[2] = {{s.buf.data(), s.buf.size()}, {const_cast<char*>(extra), extra_len}};
+    writeAll(s.fd, iov, extra_len > 0 ? 2 : 1);
+    s.buf.clear();
+}
+
+// *******************************
+
+DirectFileSink::DirectFileSink(const std::string& path, bool append,
+                               std::shared_ptr<SharedUring> ring)
+    : FileSinkBase(path, append), ring_(std::move(ring)) {
+    // positioned writes only: O_APPEND would make them ignore the offset
+    int flags = fcntl(fd_, F_GETFL);
+    if (fcntl(fd_, F_SETFL, (flags & ~O_APPEND) | O_DIRECT) != 0) {
+        std::cerr << "O_DIRECT unsupported for " << path_ << ": " << strerror(errno)
+                  << ", using buffered I/O" << std::endl;
+        fcntl(fd_, F_SETFL, flags & ~O_APPEND);
+    }
+
+    bufs_[0] = alloc_.allocate(kBufferSize);
+    bufs_[1] = alloc_.allocate(kBufferSize);
+
+    // a crash after a flush leaves the padding of the last block
+    if (offset_ > 0 && offset_ % kAlignment == 0) {
+        trimPadding();
+    }
+    loadTail();
+    allocated_ = offset_;
+
+    index_ = ring_->attach(fd_);
 }
 
-UringFileSink::~UringFileSink() { flush(); }
+DirectFileSink::~DirectFileSink() {
+    close();
+    alloc_.deallocate(bufs_[0], kBufferSize);
+    alloc_.deallocate(bufs_[1], kBufferSize);
+}
 
-void UringFileSink::log(LogMessage& msg) { aio_.write_async(msg, -1, 0); }
+void DirectFileSink::log(LogMessage& msg) {
+    const char* data = msg.data();
+    size_t size = msg.size();
+    while (size > 0) {
+        size_t n = std::min(size, kBufferSize - fill_);
+        memcpy(bufs_[cur_] + fill_, data, n);
+        fill_ += n;
+        data += n;
+        size -= n;
 
-void UringFileSink::flush() { aio_.fsync_and_wait(0); }
+        if (fill_ == kBufferSize) {
+            submit(kBufferSize);
+            // the other buffer's write was waited for in submit()
+            cur_ ^= 1;
+            file_off_ += kBufferSize;
+            fill_ = 0;
+        }
+    }
+}
+
+void DirectFileSink::flush() {
+    if (fd_ == -1) return;
+    if (fill_ > 0) {
+        // pad the partial block; it is rewritten in place once more data arrives
+        size_t len = (fill_ + kAlignment - 1) & ~(kAlignment - 1);
+        memset(bufs_[cur_] + fill_, 0, len - fill_);
+        submit(len);
+        // the file size now includes the padding: the next write of the block
+        // overwrites it, close() and a later append cut it off. Truncating here
+        // would also free the preallocated extent past the end.
+    }
+    ring_->fsync(index_, true);
+}
+
+void DirectFileSink::close() {
+    if (fd_ == -1) return;
+    flush();
+    ring_->detach(index_);
+    // release the unused part of the preallocated extent
+    off_t end = file_off_ + fill_;
+    if (fallocate_ && allocated_ > end) {
+        ::fallocate(fd_, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, end,
+                    allocated_ - end);
+    }
+    FileSinkBase::truncate(end);
+    FileSinkBase::close();
+}
+
+void DirectFileSink::truncate(off_t size) {
+    ring_->wait(index_);
+    FileSinkBase::truncate(size);
+    loadTail();
+}
+
+void DirectFileSink::trimPadding() {
+    char block[kAlignment];
+    int rfd = ::open(path_.c_str(), O_RDONLY);
+    ssize_t n = rfd < 0 ? -1 : ::pread(rfd, block, kAlignment, offset_ - kAlignment);
+    if (rfd >= 0) ::close(rfd);
+    if (n != static_cast<ssize_t>(kAlignment)) return;
+    size_t len = kAlignment;
+    while (len > 0 && block[len - 1] == '\0') len--;
+    // an all-zero block is data: padding only follows a partly filled one
+    if (len > 0 && len < kAlignment) {
+        FileSinkBase::truncate(offset_ - kAlignment + len);
+    }
+}
+
+void DirectFileSink::loadTail() {
+    // appending to an unaligned tail: reload the partial block so it is rewritten
+    file_off_ = offset_ & ~static_cast<off_t>(kAlignment - 1);
+    fill_ = offset_ - file_off_;
+    if (fill_ > 0) {
+        int rfd = ::open(path_.c_str(), O_RDONLY);
+        ssize_t n = rfd < 0 ? -1 : ::pread(rfd, bufs_[cur_], fill_, file_off_);
+        int err = errno;
+        if (rfd >= 0) ::close(rfd);
+        if (n != static_cast<ssize_t>(fill_)) {
+            throw std::system_error(err, std::system_category(),
+                                    "failed to read file tail");
+        }
+    }
+}
+
+void DirectFileSink::submit(size_t len) {
+    reserve(file_off_ + len);
+    // at most one buffer in flight: wait for the previous write before issuing this
+    // one, so the other buffer is free to fill once we return
+    ring_->wait(index_);
+    ring_->write(bufs_[cur_], len, file_off_, index_);
+}
+
+void DirectFileSink::reserve(off_t end) {
+    if (!fallocate_ || end <= allocated_) return;
+    off_t len = (end - allocated_ + kExtentSize - 1) / kExtentSize * kExtentSize;
+    // KEEP_SIZE: the file size only grows with the data actually written, so a crash
+    // never leaves the unwritten rest of an extent as zeros at the end of the log
+    if (::fallocate(fd_, FALLOC_FL_KEEP_SIZE, allocated_, len) != 0) {
+        // e.g. EOPNOTSUPP: let writes allocate blocks as they go
+        fallocate_ = false;
+        return;
+    }
+    allocated_ += len;
+}
+
+// *******************************
+
+CompressedFileSink::CompressedFileSink(std::unique_ptr<FileSinkBase> file, Codec codec,
+                                       size_t block_size, int level)
+    : file_(std::move(file)), codec_(codec), block_size_(block_size), level_(level) {
+    if (!codec_available(codec_)) {
+        throw std::invalid_argument("compression codec not compiled in");
+    }
+    if (codec_ == Codec::NONE && kDefaultCodec == Codec::NONE) {
+        std::cerr << "shlog built without LZ4 / zstd: " << file_->path()
+                  << " gets uncompressed blocks" << std::endl;
+    }
+
+    off_t size = lseek64(file_->fd(), 0, SEEK_END);
+    if (size < 0) {
+        throw std::system_error(errno, std::system_category(), "failed to seek end");
+    }
+
+    // appending: continue the sequence after the last complete block, found through
+    // the old index (read before it is rewritten below) and the block headers
+    std::vector<IndexEntry> blocks;
+    if (size > 0) {
+        CompressedLogReader reader(file_->path());
+        if (reader.blocks().empty()) {
+            throw std::invalid_argument(file_->path() + " is not a compressed log");
+        }
+        seq_ = reader.nextSequence();
+        blocks = reader.blocks();
+        offset_ = reader.end();
+        if (offset_ < size) {
+            // a block torn by a crash: cut it, so new blocks follow the valid ones
+            file_->truncate(offset_);
+        }
+    }
+
+    std::string index_path = file_->path() + kIndexSuffix;
+    index_fd_ = ::open(index_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+    if (index_fd_ < 0) {
+        throw std::system_error(errno, std::system_category(), "failed to open index");
+    }
+    // including the blocks the previous writer did not get to index
+    ssize_t len = blocks.size() * sizeof(IndexEntry);
+    if (len > 0 && ::write(index_fd_, blocks.data(), len) != len) {
+        std::cerr << "failed to rewrite " << index_path << ": " << strerror(errno)
+                  << std::endl;
+    }
+
+    raw_.reserve(block_size_ + 4096);
+}
+
+CompressedFileSink::~CompressedFileSink() {
+    flush();
+    ::close(index_fd_);
+}
+
+void CompressedFileSink::log(LogMessage& msg) {
+    if (count_ == 0) {
+        first_ts_ = nowNanos();
+    }
+    uint32_t len = msg.size();
+    raw_.append(reinterpret_cast<const char*>(&len), sizeof(len));
+    raw_.append(msg);
+    ++count_;
+
+    if (raw_.size() >= block_size_) {
+        seal();
+    }
+}
+
+void CompressedFileSink::flush() {
+    seal();
+    file_->flush();
+}
+
+void CompressedFileSink::sync(std::vector<SyncCallback> waiters) {
+    // the open block is part of what the waiters wait for
+    seal();
+    for (auto& cb : waiters) {
+        file_->syncAsync(std::move(cb));
+    }
+    file_->commit();
+}
+
+void CompressedFileSink::poll() {
+    if (count_ > 0 && nowNanos() - first_ts_ >=
+                          std::chrono::nanoseconds(kMaxBlockAge).count()) {
+        seal();
+    }
+    file_->commit();
+}
+
+void CompressedFileSink::seal() {
+    if (count_ == 0) return;
+
+    LogMessage block(sizeof(BlockHeader) + compress_bound(codec_, raw_.size()), '\0');
+    char* payload = block.data() + sizeof(BlockHeader);
+
+    BlockHeader hdr{};
+    hdr.magic = kBlockMagic;
+    hdr.codec = static_cast<uint8_t>(codec_);
+    hdr.raw_size = raw_.size();
+    hdr.size = compress(codec_, raw_.data(), raw_.size(), payload,
+                        block.size() - sizeof(BlockHeader), level_);
+    if (hdr.size == 0 || hdr.size >= raw_.size()) {
+        // incompressible (or failed): store the block as is
+        hdr.codec = static_cast<uint8_t>(Codec::NONE);
+        hdr.size = raw_.size();
+        memcpy(payload, raw_.data(), raw_.size());
+    }
+    hdr.count = count_;
+    hdr.first_seq = seq_;
+    hdr.first_ts = first_ts_;
+    hdr.last_ts = nowNanos();
+    memcpy(block.data(), &hdr, sizeof(hdr));
+    block.resize(sizeof(BlockHeader) + hdr.size);
+
+    IndexEntry entry{static_cast<uint64_t>(offset_), hdr.first_seq, hdr.first_ts,
+                     hdr.last_ts};
+    offset_ += block.size();
+    file_->write(block);
+    // best effort: the reader recovers unindexed blocks from their headers
+    if (::write(index_fd_, &entry, sizeof(entry)) != sizeof(entry)) {
+        std::cerr << "failed to index log block: " << strerror(errno) << std::endl;
+    }
+
+    seq_ += count_;
+    count_ = 0;
+    raw_.clear();
+}
 }  // namespace shlog
\ No newline at end of file
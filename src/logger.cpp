@@ -7,67 +7,367 @@ MTLogger::MTLogger() { stop_.store(true); }
 MTLogger::~MTLogger() { stop(); }
 
 void MTLogger::stop() {
-    stop_.store(true);
+    {
+        // no sync point is queued after this: the consumer runs every queued one
+        std::lock_guard<std::mutex> lock(syncMutex_);
+        stop_.store(true);
+    }
+    for (auto& thread : formatThreads_) {
+        thread.join();
+    }
+    formatThreads_.clear();
     if (processThread_.joinable()) {
         processThread_.join();
     }
+    formatStage_.reset();
 }
 
-void MTLogger::init(LogLevel level, SinkPtr sink) {
+void MTLogger::init(LogLevel level, SinkPtr sink, const ThreadOptions& thread_opts,
+                    size_t format_threads, const ThreadOptions& format_opts) {
     std::lock_guard<std::mutex> lock(mutex_);
 
     stop();
 
     LoggerBase::init(level, std::move(sink));
+    placeQueue(taskQueue_, thread_opts);
 
     stop_.store(false);
+    if (format_threads > 0) {
+        formatStage_ = std::make_unique<FormatStage>(format_threads);
+        for (size_t i = 0; i < format_threads; i++) {
+            formatThreads_.emplace_back([this, format_opts] {
+                apply_thread_options(format_opts);
+                formatLogTasks(taskQueue_, *formatStage_,
+                               [this] { return stop_.load(); });
+            });
+        }
+    }
     // Start the log processing thread
-    processThread_ = std::thread([this] { processLogTasks(); });
+    processThread_ = std::thread([this, thread_opts] {
+        apply_thread_options(thread_opts);
+        if (formatStage_) {
+            writeLogBatches(*formatStage_);
+        } else {
+            processLogTasks();
+        }
+        // complete the sync points still in flight
+        sink_->drain();
+    });
+}
+
+SyncFuture MTLogger::syncPoint() {
+    SyncFuture fut;
+    syncPoint([fut](bool ok) { fut.set(ok); });
+    return fut;
+}
+
+void MTLogger::syncPoint(SyncCallback cb) {
+    {
+        std::lock_guard<std::mutex> lock(syncMutex_);
+        if (!stop_) {
+            taskQueue_.emplace([this, cb = std::move(cb)]() mutable {
+                runOrdered([this, cb = std::move(cb)]() mutable {
+                    sink_->syncAsync(std::move(cb));
+                });
+            });
+            return;
+        }
+    }
+    cb(false);
 }
 
 void MTLogger::processLogTasks() {
+    LogTask tasks[kTaskBatch];
     while (true) {
-        if (stop_ && taskQueue_.empty()) {
-            break;
+        auto cnt = taskQueue_.pop_bulk(tasks, kTaskBatch);
+        if (cnt == 0) {
+            if (stop_ && taskQueue_.empty()) {
+                break;
+            }
+            sink_->commit();
+            continue;
         }
-        std::function<void()> task{nullptr};
-        if (!taskQueue_.empty()) {
-            taskQueue_.pop(task);
-            if (task) task();
+        for (size_t i = 0; i < cnt; i++) {
+            if (tasks[i]) tasks[i]();
+            tasks[i] = nullptr;
         }
+        // one sync for every sync point of the batch
+        sink_->commit();
     }
 }
 
-STLogger::STLogger() { stop_ = true; }
+STLogger::STLogger() { stop_.store(true); }
 
 STLogger::~STLogger() { stop(); }
 
 void STLogger::stop() {
-    stop_ = true;
+    {
+        // no sync point is queued after this: the consumer runs every queued one
+        std::lock_guard<std::mutex> lock(syncMutex_);
+        stop_.store(true);
+    }
+    for (auto& thread : formatThreads_) {
+        thread.join();
+    }
+    formatThreads_.clear();
     if (processThread_.joinable()) {
         processThread_.join();
     }
+    formatStage_.reset();
 }
 
-void STLogger::init(LogLevel level, SinkPtr sink) {
+void STLogger::init(LogLevel level, SinkPtr sink, const ThreadOptions& thread_opts,
+                    size_t format_threads, const ThreadOptions& format_opts) {
     stop();
 
     LoggerBase::init(level, std::move(sink));
-    stop_ = false;
+    placeQueue(taskQueue_, thread_opts);
+    stop_.store(false);
+    if (format_threads > 0) {
+        // the claim lock serializes the formatters on the single-consumer queue
+        formatStage_ = std::make_unique<FormatStage>(format_threads);
+        for (size_t i = 0; i < format_threads; i++) {
+            formatThreads_.emplace_back([this, format_opts] {
+                apply_thread_options(format_opts);
+                formatLogTasks(taskQueue_, *formatStage_,
+                               [this] { return stop_.load(); });
+            });
+        }
+    }
     // Start the log processing thread
-    processThread_ = std::thread([this] { processLogTasks(); });
+    processThread_ = std::thread([this, thread_opts] {
+        apply_thread_options(thread_opts);
+        if (formatStage_) {
+            writeLogBatches(*formatStage_);
+        } else {
+            processLogTasks();
+        }
+        // complete the sync points still in flight
+        sink_->drain();
+    });
+}
+
+SyncFuture STLogger::syncPoint() {
+    SyncFuture fut;
+    syncPoint([fut](bool ok) { fut.set(ok); });
+    return fut;
+}
+
+void STLogger::syncPoint(SyncCallback cb) {
+    {
+        std::lock_guard<std::mutex> lock(syncMutex_);
+        if (!stop_) {
+            taskQueue_.emplace([this, cb = std::move(cb)]() mutable {
+                runOrdered([this, cb = std::move(cb)]() mutable {
+                    sink_->syncAsync(std::move(cb));
+                });
+            });
+            return;
+        }
+    }
+    cb(false);
 }
 
 void STLogger::processLogTasks() {
+    LogTask tasks[kTaskBatch];
     while (true) {
-        if (stop_ && taskQueue_.empty()) {
-            break;
+        auto cnt = taskQueue_.pop_bulk(tasks, kTaskBatch);
+        if (cnt == 0) {
+            if (stop_ && taskQueue_.empty()) {
+                break;
+            }
+            sink_->commit();
+            continue;
         }
-        std::function<void()> task{nullptr};
-        if (!taskQueue_.empty()) {
-            taskQueue_.pop(task);
-            if (task) task();
+        for (size_t i = 0; i < cnt; i++) {
+            if (tasks[i]) tasks[i]();
+            tasks[i] = nullptr;
         }
+        // one sync for every sync point of the batch
+        sink_->commit();
+    }
+}
+
+ShmLogger::ShmLogger() : pid_(getpid()) { stop_.store(true); }
+
+ShmLogger::~ShmLogger() { stop(); }
+
+void ShmLogger::stop() {
+    // a forked child must not close its parent's ring
+    if (!stop_.exchange(true) && ring_.valid() && ring_.pid() == getpid()) {
+        ring_.close();
+    }
+}
+
+void ShmLogger::init(LogLevel level, size_t ring_bytes, const std::string& prefix) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // Producers write to the mapping without further synchronization once past the
+    // stop_ check, so a ring is never unmapped under them. A forked child (a single
+    // thread) gets a ring of its own.
+    if (ring_.valid() && ring_.pid() == getpid()) {
+        throw std::logic_error("ShmLogger is already initialized");
+    }
+    stop_.store(true);
+
+    setLogLevel(level);
+    pid_ = getpid();
+    ring_.create(ShmRing::make_name(prefix), ring_bytes);
+
+    stop_.store(false);
+}
+
+// Console until init: the logger is usable (setLogLevel, log) without it
+Logger::Logger(std::string name) : name_(std::move(name)) {
+    sink_ = std::make_unique<ConsoleSink>();
+}
+
+void Logger::init(LogLevel level, SinkPtr sink) {
+    setLogSink(std::move(sink));
+    setLogLevel(level);
+}
+
+void Logger::setLogSink(SinkPtr sink) {
+    // std::function needs a copyable task
+    auto holder = std::make_shared<SinkPtr>(
+        sink ? std::move(sink) : std::make_unique<ConsoleSink>());
+    taskQueue_.emplace([this, holder]() { sink_ = std::move(*holder); });
+}
+
+SyncFuture Logger::syncPoint() {
+    SyncFuture fut;
+    syncPoint([fut](bool ok) { fut.set(ok); });
+    return fut;
+}
+
+void Logger::syncPoint(SyncCallback cb) {
+    taskQueue_.emplace([this, cb = std::move(cb)]() mutable {
+        if (sink_) {
+            sink_->syncAsync(std::move(cb));
+        } else {
+            cb(false);
+        }
+    });
+}
+
+size_t Logger::processLogTasks(LogTask* tasks) {
+    auto cnt = taskQueue_.pop_bulk(tasks, kTaskBatch);
+    for (size_t i = 0; i < cnt; i++) {
+        if (tasks[i]) tasks[i]();
+        tasks[i] = nullptr;
+    }
+    // one sync for every sync point of the batch; also reaps while idle
+    if (sink_) sink_->commit();
+    return cnt;
+}
+
+LoggerRegistry::~LoggerRegistry() {
+    stop();
+    size_t cnt = count_.load(std::memory_order_acquire);
+    for (size_t i = 0; i < cnt; i++) {
+        delete loggers_[i].load(std::memory_order_relaxed);
+    }
+}
+
+Logger& LoggerRegistry::get(std::string_view name) {
+    size_t hash = std::hash<std::string_view>{}(name);
+    for (size_t i = 0; i < kTableSize; i++) {
+        Logger* logger = table_[(hash + i) % kTableSize].load(std::memory_order_acquire);
+        if (logger == nullptr) break;
+        if (logger->name() == name) return *logger;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    // probe again: another thread may have created it meanwhile
+    size_t slot = 0;
+    for (size_t i = 0; i < kTableSize; i++) {
+        slot = (hash + i) % kTableSize;
+        Logger* logger = table_[slot].load(std::memory_order_relaxed);
+        if (logger == nullptr) break;
+        if (logger->name() == name) return *logger;
+    }
+
+    size_t cnt = count_.load(std::memory_order_relaxed);
+    if (cnt == kMaxLoggers) {
+        throw std::runtime_error("too many named loggers");
+    }
+    auto* logger = new Logger(std::string(name));
+    loggers_[cnt].store(logger, std::memory_order_relaxed);
+    count_.store(cnt + 1, std::memory_order_release);
+    table_[slot].store(logger, std::memory_order_release);
+
+    if (threads_.empty()) {
+        start();
+    }
+    return *logger;
+}
+
+void LoggerRegistry::setConsumerThreads(size_t threads,
+                                        const ThreadOptions& thread_opts) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    bool running = !threads_.empty();
+    stop();
+    threadCount_ = std::max<size_t>(threads, 1);
+    threadOpts_ = thread_opts;
+    if (running) {
+        start();
+    }
+}
+
+void LoggerRegistry::start() {
+    stop_.store(false);
+    for (size_t i = 0; i < threadCount_; i++) {
+        threads_.emplace_back([this, i, n = threadCount_] {
+            apply_thread_options(threadOpts_);
+            consume(i, n);
+        });
+    }
+}
+
+void LoggerRegistry::stop() {
+    stop_.store(true);
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+    threads_.clear();
+}
+
+void LoggerRegistry::consume(size_t index, size_t threads) {
+    std::vector<LogTask> tasks(Logger::kTaskBatch);
+    size_t idle = 0;
+    while (true) {
+        size_t ran = 0;
+        size_t cnt = count_.load(std::memory_order_acquire);
+        for (size_t i = index; i < cnt; i += threads) {
+            Logger* logger = loggers_[i].load(std::memory_order_relaxed);
+            ran += logger->processLogTasks(tasks.data());
+        }
+        if (ran > 0) {
+            idle = 0;
+            continue;
+        }
+
+        if (stop_) {
+            bool empty = true;
+            for (size_t i = index; i < cnt; i += threads) {
+                Logger* logger = loggers_[i].load(std::memory_order_relaxed);
+                empty = empty && logger->taskQueue_.empty();
+            }
+            if (empty) break;
+            continue;
+        }
+        // back off once all loggers of this thread have gone quiet
+        if (++idle > kSpinRounds) {
+            std::this_thread::sleep_for(kIdleSleep);
+        }
+    }
+
+    // complete the sync points still in flight
+    size_t cnt = count_.load(std::memory_order_acquire);
+    for (size_t i = index; i < cnt; i += threads) {
+        Logger* logger = loggers_[i].load(std::memory_order_relaxed);
+        if (logger->sink_) logger->sink_->drain();
     }
 }
-}  // namespace shlog
+}  // namespace shlog
\ No newline at end of file
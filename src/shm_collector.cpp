@@ -0,0 +1,52 @@
+#include "shlog/shm_collector.h"
+
+#include <filesystem>
+#include <iostream>
+
+namespace shlog {
+
+ShmCollector::ShmCollector(SinkPtr sink, std::string prefix)
+    : sink_(std::move(sink)), prefix_(std::move(prefix) + ".") {}
+
+void ShmCollector::scan() {
+    std::error_code ec;
+    for (auto& entry : std::filesystem::directory_iterator("/dev/shm", ec)) {
+        auto name = entry.path().filename().string();
+        if (name.rfind(prefix_, 0) != 0 || rings_.count(name)) continue;
+
+        auto ring = std::make_unique<ShmRing>();
+        if (ring->attach("/" + name)) {
+            rings_.emplace(name, std::move(ring));
+        }
+    }
+}
+
+size_t ShmCollector::poll() {
+    auto emit = [this](const char* data, size_t len) {
+        LogMessage msg(data, len);
+        sink_->write(msg);
+    };
+
+    size_t cnt = 0;
+    for (auto it = rings_.begin(); it != rings_.end();) {
+        auto& ring = *it->second;
+        cnt += ring.drain(emit);
+        if (ring.producer_alive()) {
+            ++it;
+            continue;
+        }
+
+        // the producer cannot write anymore: take what it committed
+        cnt += ring.recover(emit);
+        if (ring.dropped() > 0) {
+            std::cerr << "shlog collector: pid " << ring.pid() << " dropped "
+                      << ring.dropped() << " records (ring full)" << std::endl;
+        }
+        ring.unlink();
+        it = rings_.erase(it);
+    }
+    sink_->commit();
+    return cnt;
+}
+
+}  // namespace shlog
@@ -1,6 +1,12 @@
 #include "shlog/logger.h"
+#include "shlog/log_reader.h"
 
+#include <fcntl.h>
 #include <gtest/gtest.h>
+#include <sys/stat.h>
+
+#include <filesystem>
+#include <fstream>
 
 static size_t write_count = 1 << 19;
 
@@ -29,6 +35,50 @@ TEST(STLoggerTest, ConsoleSink) {
     }
 }
 
+TEST(ConsoleSinkTest, StderrRouting) {
+    // stdout and stderr redirected to pipes, which are not terminals
+    int out[2], err[2];
+    ASSERT_EQ(pipe(out), 0);
+    ASSERT_EQ(pipe(err), 0);
+    fflush(stdout);
+    fflush(stderr);
+    int saved_out = dup(STDOUT_FILENO);
+    int saved_err = dup(STDERR_FILENO);
+    dup2(out[1], STDOUT_FILENO);
+    dup2(err[1], STDERR_FILENO);
+    {
+        shlog::ConsoleSink sink(shlog::LogLevel::WARN, true);
+        for (auto level : {shlog::LogLevel::DEBUG, shlog::LogLevel::INFO,
+                           shlog::LogLevel::WARN, shlog::LogLevel::ERROR}) {
+            shlog::LogMessage msg = fmt::format("level {}\n", static_cast<int>(level));
+            sink.write(msg, level);
+        }
+        shlog::LogMessage msg = "no level\n";
+        sink.write(msg);
+    }
+    dup2(saved_out, STDOUT_FILENO);
+    dup2(saved_err, STDERR_FILENO);
+    for (int fd : {saved_out, saved_err, out[1], err[1]}) {
+        close(fd);
+    }
+
+    auto readAll = [](int fd) {
+        std::string data;
+        char buf[4096];
+        for (ssize_t n; (n = read(fd, buf, sizeof(buf))) > 0;) data.append(buf, n);
+        close(fd);
+        return data;
+    };
+    auto level = [](shlog::LogLevel l) { return static_cast<int>(l); };
+    // no escape sequences, only WARN and above on stderr
+    EXPECT_EQ(readAll(out[0]), fmt::format("level {}\nlevel {}\nno level\n",
+                                           level(shlog::LogLevel::DEBUG),
+                                           level(shlog::LogLevel::INFO)));
+    EXPECT_EQ(readAll(err[0]), fmt::format("level {}\nlevel {}\n",
+                                           level(shlog::LogLevel::WARN),
+                                           level(shlog::LogLevel::ERROR)));
+}
+
 TEST(STLoggerTest, StandardFileSink) {
     SHLOG_INIT(shlog::LogLevel::DEBUG, std::make_unique<shlog::StandardFileSink>());
     Timer t;
@@ -51,6 +101,433 @@ TEST(STLoggerTest, UringFileSink) {
     std::cout << "Time elapsed: " << t.elapsed() << " seconds\n";
 }
 
+TEST(UringFileSinkTest, SharedRing) {
+    auto ring = shlog::SharedUring::global();
+    // the default ring is live: its options can no longer change
+    EXPECT_FALSE(shlog::SharedUring::configure({.sq_thread_idle = 10}));
+
+    constexpr size_t sinks = 3;
+    constexpr size_t count = 10000;
+    std::vector<std::unique_ptr<shlog::UringFileSink>> files;
+    for (size_t k = 0; k < sinks; k++) {
+        files.push_back(std::make_unique<shlog::UringFileSink>(
+            fmt::format("shared_ring_test_{}.log", k), false, ring));
+    }
+    for (size_t i = 0; i < count; i++) {
+        for (size_t k = 0; k < sinks; k++) {
+            shlog::LogMessage msg = fmt::format("{} {}\n", k, i);
+            files[k]->write(msg);
+        }
+    }
+    files.clear();
+
+    for (size_t k = 0; k < sinks; k++) {
+        std::ifstream in(fmt::format("shared_ring_test_{}.log", k));
+        std::string line;
+        size_t i = 0;
+        while (std::getline(in, line)) {
+            ASSERT_EQ(line, fmt::format("{} {}", k, i));
+            i++;
+        }
+        EXPECT_EQ(i, count);
+    }
+}
+
+TEST(STLoggerTest, DirectFileSink) {
+    std::string path = "direct_test.log";
+    SHLOG_INIT(shlog::LogLevel::DEBUG, std::make_unique<shlog::DirectFileSink>(path));
+    Timer t;
+    for (size_t i = 0; i < write_count; i++) {
+        SHLOG_INFO("Direct Test INFO: {}", i);
+        SHLOG_DEBUG("Direct Test DEBUG: {}", i);
+        SHLOG_ERROR("Direct Test ERROR: {}", i);
+    }
+    shlog::DefaultLogger::GetInst().stop();
+    shlog::DefaultLogger::GetInst().setLogSink(nullptr);
+    std::cout << "Time elapsed: " << t.elapsed() << " seconds\n";
+
+    // every record in order, and neither padding nor preallocation in the size
+    std::ifstream in(path);
+    std::string line;
+    size_t i = 0;
+    size_t bytes = 0;
+    const char* levels[] = {"INFO", "DEBUG", "ERROR"};
+    while (std::getline(in, line)) {
+        auto expected = fmt::format("Direct Test {}: {}", levels[i % 3], i / 3);
+        ASSERT_EQ(line.substr(line.find(": ") + 2), expected);
+        bytes += line.size() + 1;
+        i++;
+    }
+    EXPECT_EQ(i, 3 * write_count);
+    EXPECT_EQ(std::filesystem::file_size(path), bytes);
+}
+
+// Whether the test directory's filesystem preallocates with FALLOC_FL_KEEP_SIZE
+static bool fallocateSupported() {
+    int fd = ::open("fallocate_probe", O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+    bool ok = fd >= 0 && fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, 1 << 20) == 0;
+    if (fd >= 0) ::close(fd);
+    unlink("fallocate_probe");
+    return ok;
+}
+
+TEST(DirectFileSinkTest, AppendUnalignedTail) {
+    std::string path = "direct_append_test.log";
+    std::string expected;
+    {
+        shlog::DirectFileSink sink(path);
+        for (size_t i = 0; i < 1000; i++) {
+            shlog::LogMessage msg = fmt::format("first {}\n", i);
+            expected += msg;
+            sink.write(msg);
+        }
+        // the partial block is written padded; the preallocated extent survives
+        sink.flush();
+        ASSERT_NE(expected.size() % shlog::DirectFileSink::kAlignment, 0u);
+        auto size = std::filesystem::file_size(path);
+        EXPECT_EQ(size % shlog::DirectFileSink::kAlignment, 0u);
+        EXPECT_GT(size, expected.size());
+        struct stat st;
+        ASSERT_EQ(stat(path.c_str(), &st), 0);
+        if (fallocateSupported()) {
+            EXPECT_GE(st.st_blocks * 512, shlog::DirectFileSink::kExtentSize);
+        }
+
+        // a copy taken now is what a crash leaves: appending to it drops the padding
+        std::filesystem::copy_file(path, "direct_crash_test.log",
+                                   std::filesystem::copy_options::overwrite_existing);
+        {
+            shlog::DirectFileSink crashed("direct_crash_test.log", true);
+            shlog::LogMessage msg = "after crash\n";
+            crashed.write(msg);
+        }
+        std::ifstream in("direct_crash_test.log", std::ios::binary);
+        std::string content((std::istreambuf_iterator<char>(in)),
+                            std::istreambuf_iterator<char>());
+        EXPECT_TRUE(content == expected + "after crash\n");
+    }
+    {
+        // reloads the unaligned tail block and spans several buffers
+        shlog::DirectFileSink sink(path, true);
+        for (size_t i = 0; i < 300000; i++) {
+            shlog::LogMessage msg = fmt::format("second {}\n", i);
+            expected += msg;
+            sink.write(msg);
+        }
+    }
+
+    std::ifstream in(path, std::ios::binary);
+    std::string content((std::istreambuf_iterator<char>(in)),
+                        std::istreambuf_iterator<char>());
+    EXPECT_EQ(content.size(), expected.size());
+    EXPECT_TRUE(content == expected);
+}
+
+TEST(STLoggerTest, DurableUringFileSink) {
+    SHLOG_INIT(shlog::LogLevel::DEBUG, std::make_unique<shlog::UringFileSink>());
+    std::vector<shlog::SyncFuture> syncs;
+    Timer t;
+    for (size_t i = 0; i < write_count; i++) {
+        SHLOG_INFO("Durable Test INFO: {}", i);
+        if (i % 1024 == 0) {
+            syncs.push_back(SHLOG_DURABLE(shlog::LogLevel::WARN, "Durable Test: {}", i));
+        }
+    }
+    for (auto& sync : syncs) {
+        EXPECT_TRUE(sync.wait());
+    }
+    std::cout << "Time elapsed: " << t.elapsed() << " seconds\n";
+
+    // stop completes the sync points still queued or in flight, and refuses new ones
+    auto last = SHLOG_DURABLE(shlog::LogLevel::WARN, "Durable Test: {}", "last");
+    shlog::DefaultLogger::GetInst().stop();
+    EXPECT_TRUE(last.wait());
+    EXPECT_FALSE(shlog::DefaultLogger::GetInst().syncPoint().wait());
+}
+
+TEST(UringFileSinkTest, SyncAfterWrites) {
+    auto ring = std::make_shared<shlog::SharedUring>();
+    shlog::UringFileSink file("sync_order_test.log", false, ring);
+    shlog::UringFileSink other("sync_order_other_test.log", false, ring);
+
+    // more writes than one submission batch, the last queued SQE for another file:
+    // the sync must still come after every write of the file
+    size_t bytes = 0;
+    for (size_t i = 0; i < 2000; i++) {
+        shlog::LogMessage msg = fmt::format("record {}\n", i);
+        bytes += msg.size();
+        file.write(msg);
+    }
+    shlog::LogMessage msg = "other\n";
+    other.write(msg);
+
+    bool synced = false;
+    file.syncAsync([&](bool ok) {
+        EXPECT_TRUE(ok);
+        struct stat st;
+        ASSERT_EQ(fstat(file.fd(), &st), 0);
+        // a write completing after the sync would be missing here
+        EXPECT_EQ(static_cast<size_t>(st.st_size), bytes);
+        synced = true;
+    });
+    file.commit();
+    file.drain();
+    EXPECT_TRUE(synced);
+
+    // a failed write fails the next sync of its file, and only that one
+    int fd = ::open("sync_order_test.log", O_RDONLY);
+    ASSERT_GE(fd, 0);
+    int index = ring->attach(fd);
+    msg = "not written\n";
+    ring->write(msg, index);
+    std::vector<bool> results;
+    ring->fsyncAsync(index, [&](bool ok) { results.push_back(ok); });
+    ring->fsyncAsync(index, [&](bool ok) { results.push_back(ok); });
+    ring->detach(index);
+    ::close(fd);
+    EXPECT_EQ(results, (std::vector<bool>{false, true}));
+}
+
+TEST(STLoggerTest, ParallelFormatStandardFileSink) {
+    std::string path = "parallel_format_test.log";
+    SHLOG_INIT(shlog::LogLevel::DEBUG, std::make_unique<shlog::StandardFileSink>(path), {},
+               4);
+    Timer t;
+    for (size_t i = 0; i < write_count; i++) {
+        SHLOG_INFO("Parallel Test INFO: {}", i);
+    }
+    shlog::DefaultLogger::GetInst().stop();
+    std::cout << "Time elapsed: " << t.elapsed() << " seconds\n";
+
+    // output order is enqueue order
+    std::ifstream in(path);
+    std::string line;
+    size_t i = 0;
+    while (std::getline(in, line)) {
+        ASSERT_NE(line.find(fmt::format("INFO: {}", i)), std::string::npos);
+        i++;
+    }
+    EXPECT_EQ(i, write_count);
+}
+
+TEST(STLoggerTest, ParallelFormatStop) {
+    // whatever is queued before stop() is written, and its sync points complete
+    std::string path = "parallel_stop_test.log";
+    for (int round = 0; round < 200; round++) {
+        SHLOG_INIT(shlog::LogLevel::DEBUG, std::make_unique<shlog::StandardFileSink>(path),
+                   {}, 2);
+        SHLOG_INFO("Parallel Stop INFO: {}", round);
+        auto done = shlog::DefaultLogger::GetInst().syncPoint();
+        shlog::DefaultLogger::GetInst().stop();
+        ASSERT_TRUE(done.is_ready()) << "round " << round;
+        EXPECT_TRUE(done.wait());
+
+        std::ifstream in(path);
+        std::string line;
+        ASSERT_TRUE(std::getline(in, line)) << "round " << round;
+        EXPECT_NE(line.find(fmt::format("INFO: {}", round)), std::string::npos);
+    }
+}
+
+TEST(STLoggerTest, CompressedFileSink) {
+    std::string path = "compressed_test.log";
+    SHLOG_INIT(shlog::LogLevel::DEBUG,
+               std::make_unique<shlog::CompressedFileSink>(
+                   std::make_unique<shlog::UringFileSink>(path)));
+    Timer t;
+    for (size_t i = 0; i < write_count; i++) {
+        SHLOG_INFO("Compressed Test INFO: {}", i);
+    }
+    EXPECT_TRUE(shlog::DefaultLogger::GetInst().syncPoint().wait());
+    std::cout << "Time elapsed: " << t.elapsed() << " seconds\n";
+
+    shlog::CompressedLogReader reader(path);
+    EXPECT_EQ(reader.nextSequence(), write_count);
+    std::string msg;
+    reader.readSeq(write_count / 2, write_count / 2,
+                   [&](uint64_t, std::string_view m) { msg = m; });
+    EXPECT_NE(msg.find(fmt::format("INFO: {}\n", write_count / 2)), std::string::npos);
+}
+
+TEST(CompressedFileSinkTest, TimeRange) {
+    std::string path = "compressed_range.log";
+    using Clock = std::chrono::system_clock;
+    // three batches of blocks, apart in time
+    std::vector<Clock::time_point> marks;
+    {
+        shlog::CompressedFileSink sink(std::make_unique<shlog::StandardFileSink>(path),
+                                       shlog::kDefaultCodec, 256);
+        for (size_t batch = 0; batch < 3; batch++) {
+            marks.push_back(Clock::now());
+            for (size_t i = 0; i < 100; i++) {
+                shlog::LogMessage msg = fmt::format("batch {} record {}\n", batch, i);
+                sink.write(msg);
+            }
+            sink.flush();
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        marks.push_back(Clock::now());
+    }
+
+    shlog::CompressedLogReader reader(path);
+    EXPECT_GT(reader.blocks().size(), 3u);
+    std::vector<std::string> msgs;
+    auto collect = [&](uint64_t, std::string_view m) { msgs.emplace_back(m); };
+    EXPECT_EQ(reader.read(marks[1], marks[2], collect), 100u);
+    for (size_t i = 0; i < msgs.size(); i++) {
+        EXPECT_EQ(msgs[i], fmt::format("batch 1 record {}\n", i));
+    }
+    msgs.clear();
+    EXPECT_EQ(reader.read(marks[0], marks[3], collect), 300u);
+    EXPECT_EQ(reader.read(marks[3], Clock::now(), collect), 0u);
+}
+
+TEST(CompressedFileSinkTest, RecoverTornTail) {
+    std::string path = "compressed_recover.log";
+    auto writeRecords = [&](size_t first, size_t last, bool append) {
+        shlog::CompressedFileSink sink(
+            std::make_unique<shlog::StandardFileSink>(path, append), shlog::kDefaultCodec,
+            256);
+        EXPECT_EQ(sink.sequence(), first);
+        for (size_t i = first; i < last; i++) {
+            shlog::LogMessage msg = fmt::format("record {}\n", i);
+            sink.write(msg);
+        }
+    };
+    writeRecords(0, 200, false);
+
+    // a crash after some blocks were written but not indexed, and in the middle of
+    // writing one more block
+    std::string index_path = path + shlog::kIndexSuffix;
+    auto index_size = std::filesystem::file_size(index_path);
+    ASSERT_GT(index_size, 2 * sizeof(shlog::IndexEntry));
+    std::filesystem::resize_file(index_path, index_size - 2 * sizeof(shlog::IndexEntry));
+    auto valid_size = std::filesystem::file_size(path);
+    {
+        std::ofstream out(path, std::ios::app | std::ios::binary);
+        shlog::BlockHeader hdr{};
+        hdr.magic = shlog::kBlockMagic;
+        hdr.size = 1000;
+        out.write(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+        out << "torn";
+    }
+    {
+        shlog::CompressedLogReader reader(path);
+        EXPECT_TRUE(reader.indexStale());
+        EXPECT_EQ(reader.nextSequence(), 200u);
+        EXPECT_EQ(reader.end(), static_cast<off_t>(valid_size));
+    }
+
+    // appending cuts the torn block and continues the sequence
+    writeRecords(200, 300, true);
+
+    shlog::CompressedLogReader reader(path);
+    EXPECT_FALSE(reader.indexStale());
+    EXPECT_EQ(reader.nextSequence(), 300u);
+    EXPECT_EQ(reader.end(), static_cast<off_t>(std::filesystem::file_size(path)));
+    size_t next = 0;
+    size_t cnt = reader.readAll([&](uint64_t seq, std::string_view m) {
+        EXPECT_EQ(seq, next);
+        EXPECT_EQ(m, fmt::format("record {}\n", next));
+        next++;
+    });
+    EXPECT_EQ(cnt, 300u);
+
+    // a file that is not a compressed log is refused instead of truncated
+    std::string plain = "compressed_plain.log";
+    std::ofstream(plain) << "plain text\n";
+    EXPECT_THROW(
+        shlog::CompressedFileSink(std::make_unique<shlog::StandardFileSink>(plain, true)),
+        std::invalid_argument);
+    EXPECT_EQ(std::filesystem::file_size(plain), 11u);
+}
+
+TEST(STLoggerTest, StructuredStandardFileSink) {
+    SHLOG_INIT(shlog::LogLevel::DEBUG, std::make_unique<shlog::StandardFileSink>());
+    shlog::DefaultLogger::GetInst().setKVEncoder(std::make_unique<shlog::JSONEncoder>());
+    Timer t;
+    for (size_t i = 0; i < write_count; i++) {
+        SHLOG_INFO_KV("Structured Test", "id", i, "px", i * 0.5, "sym", "SHLG");
+    }
+    std::cout << "Time elapsed: " << t.elapsed() << " seconds\n";
+}
+
+TEST(KVEncoderTest, Escaping) {
+    std::string value(40, 'x');
+    value[5] = '"';
+    value[20] = '\x01';
+    value[33] = '\n';
+    shlog::KVHeader hdr{0, "INFO", "a.cpp", 1, "m"};
+
+    std::string line;
+    shlog::encodeKV(shlog::JSONEncoder(), line, hdr, std::make_tuple("v", value, "n", -1));
+    EXPECT_NE(line.find(R"("v":"xxxxx\"xxxxxxxxxxxxxx\u0001xxxxxxxxxxxx\nxxxxxx","n":-1})"),
+              std::string::npos);
+
+    shlog::encodeKV(shlog::LogfmtEncoder(), line, hdr,
+                    std::make_tuple("a", "b c", "d", "e", "f", ""));
+    EXPECT_NE(line.find(R"(a="b c" d=e f="")"), std::string::npos);
+}
+
+TEST(STLoggerTest, StructuredValuesCopied) {
+    std::string path = "structured_copy_test.log";
+    SHLOG_INIT(shlog::LogLevel::DEBUG, std::make_unique<shlog::StandardFileSink>(path));
+    shlog::DefaultLogger::GetInst().setKVEncoder(std::make_unique<shlog::JSONEncoder>());
+
+    // values pointing into buffers that are reused right after each call, including
+    // a const array member
+    struct Order {
+        char sym[8];
+    };
+    char buf[32];
+    std::string str;
+    Order order;
+    for (int i = 0; i < 100; i++) {
+        snprintf(buf, sizeof(buf), "buf %d", i);
+        str = fmt::format("str {}", i);
+        snprintf(order.sym, sizeof(order.sym), "sym %d", i);
+        const char* ptr = buf;
+        const Order& ref = order;
+        SHLOG_INFO_KV("copy", "a", buf, "p", ptr, "v", std::string_view(str), "l", "lit",
+                      "s", ref.sym);
+        memset(buf, 'x', sizeof(buf) - 1);
+        str.assign(str.size(), 'x');
+        memset(order.sym, 'x', sizeof(order.sym) - 1);
+    }
+    EXPECT_TRUE(shlog::DefaultLogger::GetInst().syncPoint().wait());
+    shlog::DefaultLogger::GetInst().stop();
+
+    std::ifstream in(path);
+    std::string line;
+    int i = 0;
+    while (std::getline(in, line)) {
+        auto fields = fmt::format(
+            R"("a":"buf {0}","p":"buf {0}","v":"str {0}","l":"lit","s":"sym {0}")", i);
+        ASSERT_NE(line.find(fields), std::string::npos) << line;
+        i++;
+    }
+    EXPECT_EQ(i, 100);
+}
+
+TEST(ThreadOptionsTest, Affinity) {
+    cpu_set_t allowed;
+    ASSERT_EQ(sched_getaffinity(0, sizeof(allowed), &allowed), 0);
+    int cpu = 0;
+    while (!CPU_ISSET(cpu, &allowed)) cpu++;
+
+    std::thread([cpu] {
+        int policy = sched_getscheduler(0);
+        shlog::apply_thread_options({.cpus = {cpu}});
+
+        cpu_set_t set;
+        ASSERT_EQ(sched_getaffinity(0, sizeof(set), &set), 0);
+        EXPECT_EQ(CPU_COUNT(&set), 1);
+        EXPECT_TRUE(CPU_ISSET(cpu, &set));
+        // no policy requested: the inherited one is kept
+        EXPECT_EQ(sched_getscheduler(0), policy);
+    }).join();
+}
+
 TEST(MTLoggerTest, ConsoleSink) {
     SHLOG_LOGGER_INIT(shlog::MTLogger, shlog::LogLevel::DEBUG);
     for (size_t i = 0; i < write_count; i++) {
@@ -70,4 +547,111 @@ TEST(MTLoggerTest, StandardFileSink) {
         SHLOG_LOGGER_ERROR(shlog::MTLogger, "File Test ERROR: {}", i);
     }
     std::cout << "Time elapsed: " << t.elapsed() << " seconds\n";
-}
\ No newline at end of file
+}
+
+TEST(MTLoggerTest, ParallelFormatOrder) {
+    // formatters hand lines to UringFileSink, which takes the buffers over
+    std::string path = "mt_parallel_format_test.log";
+    SHLOG_LOGGER_INIT(shlog::MTLogger, shlog::LogLevel::DEBUG,
+                      std::make_unique<shlog::UringFileSink>(path), {}, 3);
+    constexpr size_t producers = 4;
+    size_t per_producer = write_count / producers;
+    std::vector<std::thread> threads;
+    for (size_t p = 0; p < producers; p++) {
+        threads.emplace_back([p, per_producer] {
+            for (size_t i = 0; i < per_producer; i++) {
+                if (i % 8 == 0) {
+                    SHLOG_LOGGER_INFO_KV(shlog::MTLogger, "producer", "id", p, "seq", i);
+                } else {
+                    SHLOG_LOGGER_INFO(shlog::MTLogger, "producer {} seq {}", p, i);
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    shlog::MTLogger::GetInst().stop();
+    // the sink flushes its queued writes on destruction
+    shlog::MTLogger::GetInst().setLogSink(nullptr);
+
+    // records of one producer keep their order
+    std::vector<size_t> next(producers, 0);
+    std::ifstream in(path);
+    std::string line;
+    while (std::getline(in, line)) {
+        auto pos = line.find("producer ");
+        ASSERT_NE(pos, std::string::npos) << line;
+        pos += line.compare(pos + 9, 3, "id=") == 0 ? 12 : 9;
+        size_t p = std::stoul(line.substr(pos));
+        size_t i = std::stoul(line.substr(line.find("seq", pos) + 4));
+        ASSERT_LT(p, producers) << line;
+        ASSERT_EQ(i, next[p]) << line;
+        next[p]++;
+    }
+    for (size_t p = 0; p < producers; p++) {
+        EXPECT_EQ(next[p], per_producer);
+    }
+}
+
+TEST(NamedLoggerTest, SharedConsumer) {
+    using Net = shlog::NamedLogger<"net">;
+    using Db = shlog::NamedLogger<"db">;
+    shlog::setConsumerThreads(2);
+    SHLOG_LOGGER_INIT(Net, shlog::LogLevel::DEBUG,
+                      std::make_unique<shlog::StandardFileSink>("named_net_test.log"));
+    SHLOG_LOGGER_INIT(Db, shlog::LogLevel::WARN,
+                      std::make_unique<shlog::StandardFileSink>("named_db_test.log"));
+    EXPECT_EQ(&Net::GetInst(), &shlog::getLogger("net"));
+    Timer t;
+    for (size_t i = 0; i < write_count; i++) {
+        SHLOG_LOGGER_INFO(Net, "Named Test INFO: {}", i);
+        SHLOG_LOGGER_INFO(Db, "Named Test INFO: {}", i);
+        SHLOG_LOGGER_ERROR(Db, "Named Test ERROR: {}", i);
+    }
+    EXPECT_TRUE(Net::GetInst().syncPoint().wait());
+    EXPECT_TRUE(Db::GetInst().syncPoint().wait());
+    std::cout << "Time elapsed: " << t.elapsed() << " seconds\n";
+
+    // each file holds its own logger's records, in order; the WARN logger drops INFO
+    auto check = [](const std::string& path, const std::string& level,
+                    const std::string& name) {
+        std::ifstream in(path);
+        std::string line;
+        size_t i = 0;
+        while (std::getline(in, line)) {
+            ASSERT_NE(line.find(fmt::format("[{}][{}][", level, name)), std::string::npos)
+                << line;
+            ASSERT_TRUE(line.ends_with(fmt::format("Named Test {}: {}", level, i))) << line;
+            i++;
+        }
+        EXPECT_EQ(i, write_count);
+    };
+    check("named_net_test.log", "INFO", "net");
+    check("named_db_test.log", "ERROR", "db");
+}
+
+TEST(NamedLoggerTest, SetSinkWithoutInit) {
+    // usable before init (console), and setLogSink is queued like init
+    using Uninit = shlog::NamedLogger<"uninit">;
+    auto& logger = Uninit::GetInst();
+    logger.setLogLevel(shlog::LogLevel::INFO);
+    SHLOG_LOGGER_INFO(Uninit, "Named Test before sink");
+    EXPECT_TRUE(logger.syncPoint().wait());
+
+    std::filesystem::remove("named_uninit_test.log");
+    logger.setLogSink(std::make_unique<shlog::StandardFileSink>("named_uninit_test.log"));
+    for (size_t i = 0; i < 100; i++) {
+        SHLOG_LOGGER_INFO(Uninit, "Named Test INFO: {}", i);
+    }
+    EXPECT_TRUE(logger.syncPoint().wait());
+
+    std::ifstream in("named_uninit_test.log");
+    std::string line;
+    size_t i = 0;
+    while (std::getline(in, line)) {
+        ASSERT_TRUE(line.ends_with(fmt::format("Named Test INFO: {}", i))) << line;
+        i++;
+    }
+    EXPECT_EQ(i, 100u);
+}
@@ -0,0 +1,265 @@
+#include <gtest/gtest.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "shlog/libs/huge_page_allocator.hpp"
+#include "shlog/libs/mpmc_queue.hpp"
+#include "shlog/libs/segmented_queue.hpp"
+#include "shlog/libs/spsc_queue.hpp"
+
+static constexpr size_t bench_count = 1 << 22;
+static constexpr size_t bench_batch = 256;
+
+// producers used by the MPMC benchmark: all cores but the consumer's
+static const size_t bench_producers =
+    std::max(2u, std::thread::hardware_concurrency()) - 1;
+
+class Timer {
+   private:
+    using Clock = std::chrono::steady_clock;
+    using Second = std::chrono::duration<double, std::ratio<1> >;
+
+    std::chrono::time_point<Clock> m_beg{Clock::now()};
+
+   public:
+    void reset() { m_beg = Clock::now(); }
+
+    double elapsed() const {
+        return std::chrono::duration_cast<Second>(Clock::now() - m_beg).count();
+    }
+};
+
+static void report(const std::string& name, size_t ops, double secs) {
+    std::cout << name << ": " << ops / secs / 1e6 << " Mops/s (" << secs << " s)\n";
+}
+
+// Pops `total` items with either pop() or pop_bulk() and checks per-producer order.
+template <typename Queue>
+static void consume(Queue& q, size_t producers, size_t per_producer, bool bulk) {
+    std::vector<size_t> next(producers, 0);
+    size_t buf[bench_batch];
+    for (size_t n = 0; n < producers * per_producer;) {
+        size_t cnt = 1;
+        if (bulk) {
+            cnt = q.pop_bulk(buf, bench_batch);
+        } else {
+            while (q.empty());
+            q.pop(buf[0]);
+        }
+        for (size_t i = 0; i < cnt; i++) {
+            auto p = buf[i] / per_producer;
+            ASSERT_EQ(buf[i] % per_producer, next[p]);
+            next[p]++;
+        }
+        n += cnt;
+    }
+}
+
+template <typename Queue>
+static void produce(Queue& q, size_t p, size_t per_producer, bool bulk) {
+    size_t buf[bench_batch];
+    for (size_t i = 0; i < per_producer;) {
+        if (bulk) {
+            size_t cnt = std::min(bench_batch, per_producer - i);
+            for (size_t j = 0; j < cnt; j++) buf[j] = p * per_producer + i + j;
+            q.emplace_bulk(buf, cnt);
+            i += cnt;
+        } else {
+            q.emplace(p * per_producer + i);
+            i++;
+        }
+    }
+}
+
+template <typename Queue>
+static void run(const std::string& name, Queue& q, size_t producers, bool bulk) {
+    size_t per_producer = bench_count / producers;
+    Timer t;
+    std::vector<std::thread> threads;
+    for (size_t p = 0; p < producers; p++) {
+        threads.emplace_back([&q, p, per_producer, bulk] {
+            produce(q, p, per_producer, bulk);
+        });
+    }
+    consume(q, producers, per_producer, bulk);
+    for (auto& th : threads) th.join();
+    report(name, producers * per_producer, t.elapsed());
+    EXPECT_TRUE(q.empty());
+}
+
+TEST(SPSCQueueTest, Throughput) {
+    auto q = std::make_unique<shlog::SPSCQueue<size_t>>();
+    run("SPSC emplace/pop", *q, 1, false);
+    run("SPSC emplace_bulk/pop_bulk", *q, 1, true);
+}
+
+TEST(SPSCQueueTest, TryOps) {
+    shlog::SPSCQueue<int, 4> q;
+    for (int i = 0; i < 4; i++) EXPECT_TRUE(q.try_emplace(i));
+    EXPECT_FALSE(q.try_emplace(4));
+    int v;
+    for (int i = 0; i < 4; i++) {
+        EXPECT_TRUE(q.try_pop(v));
+        EXPECT_EQ(v, i);
+    }
+    EXPECT_FALSE(q.try_pop(v));
+}
+
+// The /proc/self/smaps entry of the mapping that contains addr.
+struct Mapping {
+    uintptr_t start{0};
+    uintptr_t end{0};
+    size_t kernel_page_kb{0};
+    size_t anon_huge_kb{0};
+    std::string flags;
+};
+
+static Mapping find_mapping(const void* addr) {
+    auto a = reinterpret_cast<uintptr_t>(addr);
+    std::ifstream smaps("/proc/self/smaps");
+    Mapping m;
+    bool found = false;
+    for (std::string line; std::getline(smaps, line);) {
+        std::istringstream is(line);
+        // "start-end perms ..." opens an entry, "Key: value" lines follow
+        if (!std::isupper(static_cast<unsigned char>(line[0]))) {
+            uintptr_t start, end;
+            char dash;
+            if (found) break;
+            if (is >> std::hex >> start >> dash >> end && a >= start && a < end) {
+                found = true;
+                m.start = start;
+                m.end = end;
+            }
+            continue;
+        }
+        if (!found) continue;
+        std::string key;
+        is >> key;
+        if (key == "KernelPageSize:") {
+            is >> m.kernel_page_kb;
+        } else if (key == "AnonHugePages:") {
+            is >> m.anon_huge_kb;
+        } else if (key == "VmFlags:") {
+            std::getline(is, m.flags);
+            m.flags += ' ';
+        }
+    }
+    return m;
+}
+
+TEST(SPSCQueueTest, HugePageAllocator) {
+    using Alloc = shlog::HugePageAllocator<size_t>;
+    const size_t page = ::sysconf(_SC_PAGESIZE);
+    Alloc alloc;
+
+    // whole huge pages: MAP_HUGETLB, or a THP-advised regular mapping
+    size_t bytes = 4 * Alloc::kHugePageSize;
+    size_t* p = alloc.allocate(bytes / sizeof(size_t));
+    auto m = find_mapping(p);
+    EXPECT_LE(m.start, reinterpret_cast<uintptr_t>(p));
+    EXPECT_GE(m.end, reinterpret_cast<uintptr_t>(p) + bytes);
+    if (m.kernel_page_kb != Alloc::kHugePageSize >> 10 &&
+        ::access("/sys/kernel/mm/transparent_hugepage", F_OK) == 0) {
+        EXPECT_NE(m.flags.find(" hg "), std::string::npos) << "flags:" << m.flags;
+    }
+    std::cout << "huge page mapping: " << m.kernel_page_kb << " kB pages, "
+              << m.anon_huge_kb << " kB THP\n";
+
+    // prefaulted: every page is resident before first use
+    std::vector<unsigned char> vec(bytes / page);
+    ASSERT_EQ(::mincore(p, bytes, vec.data()), 0);
+    EXPECT_TRUE(std::all_of(vec.begin(), vec.end(), [](auto v) { return v & 1; }));
+    alloc.deallocate(p, bytes / sizeof(size_t));
+
+    // smaller requests are rounded up to base pages only
+    p = alloc.allocate(3);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(p) % page, 0u);
+    EXPECT_EQ(::mincore(p, page, vec.data()), 0);
+    EXPECT_TRUE(vec[0] & 1);
+    alloc.deallocate(p, 3);
+
+    auto q = std::make_unique<
+        shlog::SPSCQueue<size_t, 1 << 20, shlog::HugePageAllocator<size_t>>>();
+    run("SPSC huge pages emplace_bulk/pop_bulk", *q, 1, true);
+}
+
+// Scales over 1, 2, 4, ... producers up to all cores but the consumer's, so the
+// contention the padding and bulk APIs target shows up on machines of any size.
+TEST(MPMCQueueTest, Throughput) {
+    auto q = std::make_unique<shlog::MPMCQueue<size_t>>();
+    for (size_t producers = 1;; producers = std::min(2 * producers, bench_producers)) {
+        auto suffix = " (" + std::to_string(producers) + " producers)";
+        run("MPMC emplace/pop" + suffix, *q, producers, false);
+        run("MPMC emplace_bulk/pop_bulk" + suffix, *q, producers, true);
+        if (producers == bench_producers) break;
+    }
+}
+
+TEST(MPMCQueueTest, TryOps) {
+    shlog::MPMCQueue<int, 4> q;
+    for (int i = 0; i < 4; i++) EXPECT_TRUE(q.try_emplace(i));
+    EXPECT_FALSE(q.try_emplace(4));
+    int v;
+    for (int i = 0; i < 4; i++) {
+        EXPECT_TRUE(q.try_pop(v));
+        EXPECT_EQ(v, i);
+    }
+    EXPECT_FALSE(q.try_pop(v));
+}
+
+TEST(SegmentedQueueTest, MultiProducerOrder) {
+    constexpr size_t producers = 4;
+    constexpr size_t per_producer = 1 << 16;
+
+    // small budget so producers wrap the block directory and wait on the consumer
+    constexpr size_t budget = 8 * shlog::SegmentedQueue<size_t, 256>::kSegmentBytes;
+    shlog::SegmentedQueue<size_t, 256> q(budget, 2);
+    EXPECT_EQ(q.capacity_bytes(), budget);
+
+    std::vector<std::thread> threads;
+    for (size_t p = 0; p < producers; p++) {
+        threads.emplace_back([&q, p] {
+            for (size_t i = 0; i < per_producer; i++) {
+                q.emplace(p * per_producer + i);
+            }
+        });
+    }
+    consume(q, producers, per_producer, true);
+
+    for (auto& t : threads) t.join();
+    EXPECT_TRUE(q.empty());
+    EXPECT_EQ(q.alloc_failures(), 0u);
+}
+
+TEST(SegmentedQueueTest, GrowAndShrink) {
+    using Queue = shlog::SegmentedQueue<size_t, 64>;
+    constexpr size_t segments = 16;
+    Queue q(64 * Queue::kSegmentBytes, 2);
+    EXPECT_EQ(q.segment_count(), 2u);  // the recycle pool
+
+    // a burst takes segments beyond the pool...
+    for (size_t i = 0; i < segments * 64; i++) {
+        q.emplace(i);
+    }
+    EXPECT_EQ(q.segment_count(), segments);
+
+    // ...and draining it frees all but the pool again
+    size_t v;
+    for (size_t i = 0; i < segments * 64; i++) {
+        q.pop(v);
+        ASSERT_EQ(v, i);
+    }
+    EXPECT_TRUE(q.empty());
+    EXPECT_EQ(q.segment_count(), 2u);
+}
@@ -0,0 +1,236 @@
+#include <gtest/gtest.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "shlog/libs/shm_ring.h"
+#include "shlog/logger.h"
+#include "shlog/shm_collector.h"
+
+static const std::string test_prefix = "shlog_test_" + std::to_string(getpid());
+
+// Records of different sizes, so padding to the ring end happens at varying offsets
+static std::string record(size_t i) {
+    return "record " + std::to_string(i) + " " + std::string(i % 200, 'x');
+}
+
+static std::vector<std::string> drainAll(shlog::ShmRing& ring) {
+    std::vector<std::string> out;
+    ring.drain([&](const char* data, size_t len) { out.emplace_back(data, len); });
+    return out;
+}
+
+TEST(ShmRingTest, Wraparound) {
+    shlog::ShmRing ring;
+    ring.create(shlog::ShmRing::make_name(test_prefix), 4096);
+
+    // several hundred laps of the ring, drained every few records
+    size_t next = 0;
+    for (size_t i = 0; i < 20000; i++) {
+        auto msg = record(i);
+        ASSERT_TRUE(ring.write(msg.data(), msg.size()));
+        if (i % 7 == 6) {
+            for (auto& r : drainAll(ring)) {
+                ASSERT_EQ(r, record(next++));
+            }
+        }
+    }
+    for (auto& r : drainAll(ring)) {
+        ASSERT_EQ(r, record(next++));
+    }
+    EXPECT_EQ(next, 20000u);
+    EXPECT_TRUE(ring.empty());
+    EXPECT_EQ(ring.dropped(), 0u);
+    ring.unlink();
+}
+
+TEST(ShmRingTest, FullRingDrops) {
+    shlog::ShmRing ring;
+    ring.create(shlog::ShmRing::make_name(test_prefix), 4096);
+
+    // records that do not fit are dropped and counted, never block the caller
+    std::string msg(100, 'a');
+    size_t written = 0;
+    while (ring.write(msg.data(), msg.size())) written++;
+    EXPECT_GT(written, 0u);
+    EXPECT_FALSE(ring.write(msg.data(), msg.size()));
+    EXPECT_EQ(ring.dropped(), 2u);
+
+    // too large for the ring at all
+    std::string big(4096, 'b');
+    EXPECT_FALSE(ring.write(big.data(), big.size()));
+    EXPECT_EQ(ring.dropped(), 3u);
+
+    // draining makes room again
+    EXPECT_EQ(drainAll(ring).size(), written);
+    EXPECT_TRUE(ring.write(msg.data(), msg.size()));
+    ring.unlink();
+}
+
+TEST(ShmRingTest, DrainReopenedRing) {
+    auto name = shlog::ShmRing::make_name(test_prefix);
+    shlog::ShmRing producer;
+    producer.create(name, 1 << 16);
+    for (size_t i = 0; i < 100; i++) {
+        auto msg = record(i);
+        ASSERT_TRUE(producer.write(msg.data(), msg.size()));
+    }
+
+    size_t next = 0;
+    {
+        shlog::ShmRing collector;
+        ASSERT_TRUE(collector.attach(name));
+        EXPECT_EQ(collector.pid(), getpid());
+        for (auto& r : drainAll(collector)) {
+            ASSERT_EQ(r, record(next++));
+        }
+    }
+    for (size_t i = 100; i < 150; i++) {
+        auto msg = record(i);
+        ASSERT_TRUE(producer.write(msg.data(), msg.size()));
+    }
+
+    // a restarted collector continues where the previous one stopped
+    shlog::ShmRing collector;
+    ASSERT_TRUE(collector.attach(name));
+    for (auto& r : drainAll(collector)) {
+        ASSERT_EQ(r, record(next++));
+    }
+    EXPECT_EQ(next, 150u);
+    EXPECT_TRUE(collector.producer_alive());
+    producer.close();
+    EXPECT_FALSE(collector.producer_alive());
+    collector.unlink();
+}
+
+TEST(ShmRingTest, RecoverAfterProducerExit) {
+    auto name = shlog::ShmRing::make_name(test_prefix);
+    pid_t pid = fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0) {
+        // producer that exits without closing its ring
+        shlog::ShmRing ring;
+        ring.create(name, 1 << 16);
+        for (size_t i = 0; i < 50; i++) {
+            auto msg = record(i);
+            ring.write(msg.data(), msg.size());
+        }
+        _exit(0);
+    }
+    int status;
+    ASSERT_EQ(waitpid(pid, &status, 0), pid);
+
+    shlog::ShmRing ring;
+    ASSERT_TRUE(ring.attach(name));
+    EXPECT_FALSE(ring.producer_alive());
+    size_t next = 0;
+    ring.recover([&](const char* data, size_t len) {
+        EXPECT_EQ(std::string(data, len), record(next++));
+    });
+    EXPECT_EQ(next, 50u);
+    EXPECT_TRUE(ring.empty());
+    ring.unlink();
+}
+
+TEST(ShmRingTest, DeadProducerWithLivePid) {
+    // The producer goes away without closing its ring while the pid in the header
+    // stays alive, as when the pid is reused by another process: here it is our own.
+    auto name = shlog::ShmRing::make_name(test_prefix);
+    {
+        shlog::ShmRing producer;
+        producer.create(name, 1 << 16);
+        for (size_t i = 0; i < 20; i++) {
+            auto msg = record(i);
+            ASSERT_TRUE(producer.write(msg.data(), msg.size()));
+        }
+    }
+
+    shlog::ShmRing ring;
+    ASSERT_TRUE(ring.attach(name));
+    EXPECT_EQ(ring.pid(), getpid());
+    EXPECT_FALSE(ring.producer_alive());
+    size_t next = 0;
+    ring.recover([&](const char* data, size_t len) {
+        EXPECT_EQ(std::string(data, len), record(next++));
+    });
+    EXPECT_EQ(next, 20u);
+    ring.unlink();
+}
+
+TEST(ShmCollectorTest, DrainAndRemoveRings) {
+    std::string path = "shm_collector_test.log";
+    shlog::ShmCollector collector(std::make_unique<shlog::StandardFileSink>(path),
+                                  test_prefix);
+
+    shlog::ShmRing producers[2];
+    for (auto& p : producers) {
+        p.create(shlog::ShmRing::make_name(test_prefix), 1 << 16);
+    }
+    collector.scan();
+    EXPECT_EQ(collector.rings(), 2u);
+
+    for (size_t i = 0; i < 10; i++) {
+        auto msg = record(i) + "\n";
+        producers[i % 2].write(msg.data(), msg.size());
+    }
+    EXPECT_EQ(collector.poll(), 10u);
+
+    // a closed ring is drained one last time and removed
+    auto msg = record(10) + "\n";
+    producers[0].write(msg.data(), msg.size());
+    producers[0].close();
+    EXPECT_EQ(collector.poll(), 1u);
+    EXPECT_EQ(collector.rings(), 1u);
+    EXPECT_FALSE(std::filesystem::exists("/dev/shm" + producers[0].name()));
+
+    producers[1].close();
+    collector.poll();
+    EXPECT_EQ(collector.rings(), 0u);
+    collector.flush();
+
+    std::ifstream in(path);
+    std::vector<std::string> lines;
+    for (std::string line; std::getline(in, line);) lines.push_back(line);
+    ASSERT_EQ(lines.size(), 11u);
+    // per ring in order; rings are drained one after the other
+    std::sort(lines.begin(), lines.end(), [](auto& a, auto& b) {
+        return std::stoi(a.substr(7)) < std::stoi(b.substr(7));
+    });
+    for (size_t i = 0; i < lines.size(); i++) {
+        EXPECT_EQ(lines[i], record(i));
+    }
+}
+
+TEST(ShmLoggerTest, InitOnce) {
+    std::string prefix = test_prefix + "_logger";
+    auto& logger = shlog::ShmLogger::GetInst();
+    logger.init(shlog::LogLevel::INFO, 1 << 16, prefix);
+    logger.log<shlog::LogLevel::INFO>(__FILE__, __LINE__, "first {}", 1);
+
+    // the mapping stays valid for producers; re-init is refused even after stop
+    EXPECT_THROW(logger.init(shlog::LogLevel::INFO, 1 << 16, prefix), std::logic_error);
+    logger.stop();
+    EXPECT_THROW(logger.init(shlog::LogLevel::INFO, 1 << 16, prefix), std::logic_error);
+    logger.log<shlog::LogLevel::INFO>(__FILE__, __LINE__, "dropped after stop");
+
+    std::string path = "shm_logger_test.log";
+    {
+        shlog::ShmCollector collector(std::make_unique<shlog::StandardFileSink>(path),
+                                      prefix);
+        collector.scan();
+        ASSERT_EQ(collector.rings(), 1u);
+        EXPECT_EQ(collector.poll(), 1u);
+        EXPECT_EQ(collector.rings(), 0u);
+        collector.flush();
+    }
+    std::ifstream in(path);
+    std::string line;
+    ASSERT_TRUE(std::getline(in, line));
+    EXPECT_NE(line.find("first 1"), std::string::npos);
+    EXPECT_FALSE(std::getline(in, line));
+}